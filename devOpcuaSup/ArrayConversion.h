@@ -0,0 +1,220 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#ifndef DEVOPCUA_ARRAYCONVERSION_H
+#define DEVOPCUA_ARRAYCONVERSION_H
+
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+namespace DevOpcua {
+
+/**
+ * @brief Saturating conversion of a single numeric value.
+ *
+ * Specialized on the integer-ness of the types, all decisions on which checks
+ * are needed are made at compile time.
+ * Both functions evaluate all comparisons unconditionally and only select
+ * between results (no short-circuit evaluation), so that loops over them
+ * can be if-converted and vectorized by the compiler.
+ *
+ * outOfRange() returns true if the value is not representable in the target
+ * type (NaN into an integer type, or a value beyond the target range);
+ * convert() returns the value clamped to the target range (NaN becomes 0).
+ * Precision loss (e.g. Int64 to Double, rounding of float to integer
+ * by truncation) is not considered out of range.
+ */
+template<typename TO, typename FROM,
+         bool toInteger = std::numeric_limits<TO>::is_integer,
+         bool fromInteger = std::numeric_limits<FROM>::is_integer>
+struct Saturate;
+
+// integer <- integer
+template<typename TO, typename FROM>
+struct Saturate<TO, FROM, true, true>
+{
+    typedef std::numeric_limits<TO> T;
+    typedef std::numeric_limits<FROM> F;
+    static const bool checkLow = F::is_signed && (!T::is_signed || F::digits > T::digits);
+    static const bool checkHigh = F::digits > T::digits;
+
+    static bool below (const FROM v) { return checkLow & (v < static_cast<FROM>(T::lowest())); }
+    static bool above (const FROM v) { return checkHigh & (v > static_cast<FROM>(T::max())); }
+    static bool outOfRange (const FROM v) { return below(v) | above(v); }
+    static TO convert (const FROM v)
+    {
+        const bool lo = below(v), hi = above(v);
+        const TO r = static_cast<TO>(v);
+        return lo ? T::lowest() : hi ? T::max() : r;
+    }
+};
+
+// integer <- floating point
+template<typename TO, typename FROM>
+struct Saturate<TO, FROM, true, false>
+{
+    typedef std::numeric_limits<TO> T;
+    // Limits are powers of 2, i.e. exact in any floating point type
+    static FROM low () { return static_cast<FROM>(T::lowest()); }
+    static FROM high () { return static_cast<FROM>(T::max() / 2 + 1) * 2; }
+
+    static bool below (const FROM v) { return v < low(); }
+    static bool above (const FROM v) { return v >= high(); }
+    static bool outOfRange (const FROM v) { return (v != v) | below(v) | above(v); }
+    static TO convert (const FROM v)
+    {
+        // only convert values in range, out of range conversion is undefined
+        const bool lo = below(v), hi = above(v);
+        const TO r = static_cast<TO>(((v != v) | lo | hi) ? FROM(0) : v);
+        return lo ? T::lowest() : hi ? T::max() : r;
+    }
+};
+
+// floating point <- integer (always in range)
+template<typename TO, typename FROM>
+struct Saturate<TO, FROM, false, true>
+{
+    static bool outOfRange (const FROM) { return false; }
+    static TO convert (const FROM v) { return static_cast<TO>(v); }
+};
+
+// floating point <- floating point (infinities and NaN are kept)
+template<typename TO, typename FROM>
+struct Saturate<TO, FROM, false, false>
+{
+    typedef std::numeric_limits<TO> T;
+    typedef std::numeric_limits<FROM> F;
+    static const bool checkRange = F::max_exponent > T::max_exponent;
+
+    static bool below (const FROM v)
+    {
+        return checkRange & (v < static_cast<FROM>(T::lowest())) & (v >= F::lowest());
+    }
+    static bool above (const FROM v)
+    {
+        return checkRange & (v > static_cast<FROM>(T::max())) & (v <= F::max());
+    }
+    static bool outOfRange (const FROM v) { return below(v) | above(v); }
+    static TO convert (const FROM v)
+    {
+        if (!checkRange)
+            return static_cast<TO>(v);
+        // clamp, then put back infinities (this form is vectorized by GCC 12)
+        FROM c = v < static_cast<FROM>(T::lowest()) ? static_cast<FROM>(T::lowest()) : v;
+        c = c > static_cast<FROM>(T::max()) ? static_cast<FROM>(T::max()) : c;
+        c = (v == F::infinity()) | (v == -F::infinity()) ? v : c;
+        return static_cast<TO>(c);
+    }
+};
+
+// Number of elements that are checked and converted at a time.
+// Range check and conversion are separate loops (compilers, e.g. GCC 12,
+// do not vectorize the combined loop), running them on chunks that stay
+// in the L1 cache makes them a single pass over memory.
+const size_t conversionChunk = 1024;
+
+/**
+ * @brief Checks if any element of a numeric array is out of range for the target type.
+ *
+ * The flag is kept in the source type as a conditional select, as compilers
+ * do not vectorize counting the results of floating point comparisons in an integer.
+ * For widening conversions, the loop is optimized away.
+ *
+ * @param from  source array (at least n elements)
+ * @param n  number of elements to check
+ *
+ * @return  true if any element is out of range
+ */
+template<typename TO, typename FROM>
+inline bool
+anyOutOfRange (const FROM *from, const size_t n)
+{
+    FROM out = 0;
+    for (size_t i = 0; i < n; i++)
+        out = Saturate<TO, FROM>::outOfRange(from[i]) ? FROM(1) : out;
+    return out != 0;
+}
+
+/**
+ * @brief Element-wise saturating conversion of a numeric array.
+ *
+ * Plain loops without dependencies between elements, which the compiler
+ * vectorizes where the target supports the conversion (and leaves as
+ * scalar code where it does not). Arrays of the same type are copied.
+ *
+ * @param to  target array (at least n elements)
+ * @param from  source array (at least n elements)
+ * @param n  number of elements to convert
+ *
+ * @return  true if any element was out of range (and has been clamped)
+ */
+template<typename TO, typename FROM>
+inline bool
+convertArray (TO *to, const FROM *from, const size_t n)
+{
+    bool clipped = false;
+    for (size_t start = 0; start < n; start += conversionChunk) {
+        const size_t end = n - start < conversionChunk ? n : start + conversionChunk;
+        clipped |= anyOutOfRange<TO>(from + start, end - start);
+        for (size_t i = start; i < end; i++)
+            to[i] = Saturate<TO, FROM>::convert(from[i]);
+    }
+    return clipped;
+}
+
+template<typename T>
+inline bool
+convertArray (T *to, const T *from, const size_t n)
+{
+    memcpy(to, from, sizeof(T) * n);
+    return false;
+}
+
+/**
+ * @brief Element-wise range checked conversion of a numeric array.
+ *
+ * Stops at the first chunk that contains an element out of range,
+ * i.e. the target array is incomplete if an element is out of range.
+ *
+ * @param to  target array (at least n elements)
+ * @param from  source array (at least n elements)
+ * @param n  number of elements to convert
+ *
+ * @return  index of the first element out of range, n if all elements are in range
+ */
+template<typename TO, typename FROM>
+inline size_t
+convertArrayChecked (TO *to, const FROM *from, const size_t n)
+{
+    for (size_t start = 0; start < n; start += conversionChunk) {
+        const size_t end = n - start < conversionChunk ? n : start + conversionChunk;
+        if (anyOutOfRange<TO>(from + start, end - start)) {
+            for (size_t i = start; i < end; i++)
+                if (Saturate<TO, FROM>::outOfRange(from[i]))
+                    return i;
+        }
+        for (size_t i = start; i < end; i++)
+            to[i] = Saturate<TO, FROM>::convert(from[i]);
+    }
+    return n;
+}
+
+template<typename T>
+inline size_t
+convertArrayChecked (T *to, const T *from, const size_t n)
+{
+    memcpy(to, from, sizeof(T) * n);
+    return n;
+}
+
+} // namespace DevOpcua
+
+#endif // DEVOPCUA_ARRAYCONVERSION_H
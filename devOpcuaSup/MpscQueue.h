@@ -0,0 +1,245 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#ifndef DEVOPCUA_MPSCQUEUE_H
+#define DEVOPCUA_MPSCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <epicsTime.h>
+
+#include "SparePool.h"
+
+namespace DevOpcua {
+
+/**
+ * @class MpscQueue
+ * @brief A lock-free multi-producer single-consumer FIFO of shared_ptr to cargo.
+ *
+ * Intrusive linked list with a stub node (D. Vyukov's MPSC node queue).
+ * Producers only need one atomic exchange to append an element (or a chain of
+ * elements), they never block each other or the consumer.
+ *
+ * Only one thread at a time may call the consumer side methods (pop, clear);
+ * the caller is responsible for serializing them.
+ *
+ * A producer that was preempted between the exchange and the linking store
+ * hides the elements that were appended after it from the consumer until it resumes.
+ * pop() returns false in that case while size() is not zero; the consumer is
+ * expected to retry later.
+ *
+ * Every element carries the time when it was pushed (for wait time statistics
+ * and age limits).
+ *
+ * To avoid heap allocations in steady state, nodes are recycled through a
+ * bounded lock-free pool of spare nodes (SparePool):
+ * the consumer returns popped nodes, producers take them for new elements.
+ * Nodes are only allocated when the pool is empty, and only freed when it is full.
+ *
+ * The template parameter T is the class of the cargo.
+ */
+template<typename T>
+class MpscQueue
+{
+    struct Node {
+        Node() : next(nullptr) {}
+        std::atomic<Node *> next;
+        std::shared_ptr<T> cargo;
+        epicsTime enqueued;
+    };
+
+public:
+    /**
+     * @brief Construct a queue.
+     *
+     * @param spareNodes  capacity of the spare node pool (rounded up to a power of 2)
+     */
+    explicit MpscQueue(const size_t spareNodes = 1024)
+        : head(new Node)
+        , tail(head.load(std::memory_order_relaxed))
+        , count(0)
+        , pool(spareNodes)
+    {}
+
+    ~MpscQueue()
+    {
+        clear();
+        delete tail;
+        while (Node *n = pool.get())
+            delete n;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    /**
+     * @brief Appends an element (producer side, thread safe).
+     *
+     * @param cargo  shared_ptr to the element
+     *
+     * @return  `true` if the queue was empty before the push
+     */
+    bool push(std::shared_ptr<T> cargo)
+    {
+        Node *n = newNode(std::move(cargo), epicsTime::getCurrent());
+        bool wasEmpty = (count.fetch_add(1, std::memory_order_acq_rel) == 0);
+        link(n, n);
+        return wasEmpty;
+    }
+
+    /**
+     * @brief Appends a vector of elements as one contiguous chain (producer side, thread safe).
+     *
+     * @param cargo  vector of shared_ptr to the elements
+     *
+     * @return  `true` if the queue was empty before the push
+     */
+    bool push(const std::vector<std::shared_ptr<T>> &cargo)
+    {
+        if (cargo.empty())
+            return false;
+        epicsTime now = epicsTime::getCurrent();
+        Node *first = newNode(std::shared_ptr<T>(cargo.front()), now);
+        Node *last = first;
+        for (auto it = cargo.begin() + 1; it != cargo.end(); ++it) {
+            Node *n = newNode(std::shared_ptr<T>(*it), now);
+            last->next.store(n, std::memory_order_relaxed);
+            last = n;
+        }
+        bool wasEmpty = (count.fetch_add(cargo.size(), std::memory_order_acq_rel) == 0);
+        link(first, last);
+        return wasEmpty;
+    }
+
+    /**
+     * @brief Removes the oldest element (consumer side).
+     *
+     * @param[out] cargo  shared_ptr to the removed element
+     *
+     * @return  `true` if an element was removed, `false` if none is available (yet)
+     */
+    bool pop(std::shared_ptr<T> &cargo)
+    {
+        epicsTime enqueued;
+        return pop(cargo, enqueued);
+    }
+
+    /**
+     * @brief Removes the oldest element (consumer side), returning its push time.
+     *
+     * @param[out] cargo  shared_ptr to the removed element
+     * @param[out] enqueued  time when the element was pushed
+     *
+     * @return  `true` if an element was removed, `false` if none is available (yet)
+     */
+    bool pop(std::shared_ptr<T> &cargo, epicsTime &enqueued)
+    {
+        Node *t = tail;
+        Node *next = t->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+        cargo = std::move(next->cargo);
+        enqueued = next->enqueued;
+        tail = next;
+        if (!pool.put(t))
+            delete t;
+        count.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    /**
+     * @brief Returns the oldest element without removing it (consumer side).
+     *
+     * @return  pointer to the oldest element, nullptr if none is available (yet)
+     */
+    T *front() const
+    {
+        Node *next = tail->next.load(std::memory_order_acquire);
+        return next ? next->cargo.get() : nullptr;
+    }
+
+    /**
+     * @brief Returns the push time of the oldest element (consumer side).
+     *
+     * @param[out] enqueued  time when the oldest element was pushed
+     *
+     * @return  `true` if an element is available, `false` otherwise
+     */
+    bool frontTime(epicsTime &enqueued) const
+    {
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+        enqueued = next->enqueued;
+        return true;
+    }
+
+    /**
+     * @brief Removes all available elements (consumer side).
+     */
+    void clear()
+    {
+        std::shared_ptr<T> dummy;
+        while (pop(dummy))
+            dummy.reset();
+    }
+
+    /**
+     * @brief Returns the number of elements (pushed and not yet popped).
+     *
+     * An element is counted before its producer has linked it in, so for a moment
+     * the queue may be non-empty while pop() does not return anything yet.
+     *
+     * @return  number of elements in the queue
+     */
+    size_t size() const { return count.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Checks whether the queue is empty.
+     * @return  `true` if the queue is empty, `false` otherwise
+     */
+    bool empty() const { return size() == 0; }
+
+    /**
+     * @brief Returns the number of spare nodes in the pool (approximate).
+     * @return  number of spare nodes
+     */
+    size_t spareNodes() const { return pool.size(); }
+
+private:
+    Node *newNode(std::shared_ptr<T> &&cargo, const epicsTime &enqueued)
+    {
+        Node *n = pool.get();
+        if (n)
+            n->next.store(nullptr, std::memory_order_relaxed);
+        else
+            n = new Node;
+        n->cargo = std::move(cargo);
+        n->enqueued = enqueued;
+        return n;
+    }
+
+    void link(Node *first, Node *last)
+    {
+        Node *prev = head.exchange(last, std::memory_order_acq_rel);
+        prev->next.store(first, std::memory_order_release);
+    }
+
+    std::atomic<Node *> head;    /**< producer end (last node) */
+    Node *tail;                  /**< consumer end (stub / last popped node) */
+    std::atomic<size_t> count;   /**< number of elements */
+    SparePool<Node *> pool;      /**< spare node pool */
+};
+
+} // namespace DevOpcua
+
+#endif // DEVOPCUA_MPSCQUEUE_H
@@ -11,17 +11,21 @@
 #ifndef DEVOPCUA_REQUESTQUEUEBATCHER_H
 #define DEVOPCUA_REQUESTQUEUEBATCHER_H
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
-#include <queue>
 #include <vector>
 #include <iostream>
 
 #include <epicsMutex.h>
 #include <epicsEvent.h>
 #include <epicsThread.h>
+#include <epicsTime.h>
 #include <menuPriority.h>
 
 #include "devOpcua.h"
+#include "MpscQueue.h"
+#include "TokenBucket.h"
 
 namespace DevOpcua {
 
@@ -33,12 +37,61 @@ namespace DevOpcua {
  * specifying the EPICS priority.
  * (Internally a set of 3 queues is used to implement priority queueing.)
  *
+ * The queues are lock-free multi-producer single-consumer queues, so that
+ * many threads (e.g. the EPICS callback threads) can push requests without
+ * contending on a lock. Draining (worker thread) and clearing are serialized
+ * by a lock that is never taken by producers.
+ *
  * A worker thread pops requests from the queue and collects them into
  * a batch (std::vector<>), honoring the configured limit of items per service
  * request. The batch is delivered to the consumer (lower level library) followed
  * by waiting the configured hold-off time (linear interpolation between a minimal
  * time (after a batch of size 1) and a maximum (after a full batch).
  *
+ * In adaptive mode (a latency target is set), the consumer reports the measured
+ * round trip time of each batch. The batch size limit and the hold-off are then
+ * adjusted AIMD-style: while the latency is below the target, the batch size is
+ * increased and the hold-off decreased in small steps; when it exceeds the target,
+ * the batch size is halved and the hold-off doubled.
+ *
+ * By default, the queues are drained in strict priority order, which may starve
+ * lower priorities under sustained load. If weights are set, a deficit round robin
+ * scheme is used across the priorities instead, where every priority gets a share
+ * of the batches that is proportional to its weight. (The round continues across
+ * batches, so this also holds for batch limits below the weights.)
+ * (Inside a batch, requests are always ordered by priority.)
+ * For every priority, the time that requests spent in the queue is accounted.
+ *
+ * With an age limit set, the worker holds back a partial batch until either
+ * enough requests for a full batch are queued or the oldest queued request
+ * reaches the age limit, creating larger batches at low request rates while
+ * bounding the delay of every request.
+ *
+ * Optionally, batches can also be limited by a byte budget: the consumer
+ * reports the cost (e.g. the encoded size) of each request, and a batch is closed
+ * before the request that would exceed the budget. (A single request that
+ * exceeds the budget on its own is sent in a batch by itself.)
+ *
+ * Token buckets for service calls and nodes (which may be shared between
+ * several batchers) can be attached to limit the rate of outgoing requests:
+ * before delivering a batch, the worker takes one call token and one node token
+ * per request, and waits as long as the buckets demand.
+ *
+ * With the express lane enabled, HIGH priority requests bypass hold-off time,
+ * age limit and window: they are sent immediately in their own (minimal) batch,
+ * also while the worker is waiting. Express batches are subject to the byte
+ * budget and wait for the rate limiters like all other batches.
+ * Their time in the queue is accounted separately.
+ *
+ * Optionally, the number of batches that have been delivered but not yet
+ * completed (outstanding service calls) can be limited to a window.
+ * In that mode, sending is driven by completions (reported by the consumer
+ * through completeBatch()) instead of the hold-off time: the worker sends the
+ * next batch as soon as a credit is available.
+ * Each delivered batch belongs to a generation (see batchGeneration()), which
+ * clear() advances, so that late completions of batches delivered before
+ * a clear() do not return credits.
+ *
  * The template parameter T is the implementation specific request cargo class
  * (i.e., the class of the things to be queued).
  */
@@ -66,6 +119,19 @@ public:
      * @param batch  vector of requests (shared_ptr to cargo)
      */
     virtual void processRequests(std::vector<std::shared_ptr<T>> &batch) = 0;
+
+    /**
+     * @brief Get the cost of a request.
+     *
+     * Called from the batcher thread (only if a byte budget is set) for
+     * every request before adding it to a batch.
+     * The default implementation returns 0 (only the number of requests counts).
+     *
+     * @param cargo  request
+     *
+     * @return  cost of the request, e.g. its encoded size [bytes]
+     */
+    virtual size_t requestCost(const T &cargo) { (void)cargo; return 0; }
 };
 
 template<typename T>
@@ -95,10 +161,36 @@ public:
         : maxBatchSize(0)
         , holdOffVar(0.0)
         , holdOffFix(0.0)
+        , latencyTarget(0.0)
+        , latencyAvg(0.0)
+        , adaptiveMax(0)
+        , adaptiveHoldOff(0.0)
+        , requestsCap(0)
+        , capSuccesses(0)
+        , maxBatchBytes(0)
+        , batchBytes(0)
+        , batchCount(0)
+        , budgetExhausted(false)
+        , budgetLimited(0)
+        , callLimiter(nullptr)
+        , nodeLimiter(nullptr)
+        , maxOutstanding(0)
+        , outstanding(0)
+        , generation(0)
+        , deliveredGeneration(0)
+        , ageLimit(0.0)
+        , expressLane(false)
+        , expressBatches(0)
+        , weighted(false)
+        , weight{1, 1, 1}
+        , deficit{0, 0, 0}
+        , drrPrio(menuPriorityHIGH)
+        , drrCredited(false)
         , worker(*this, name.c_str(),
                  epicsThreadGetStackSize(epicsThreadStackSmall),
                  epicsThreadPriorityMedium)
         , workToDo(epicsEventEmpty)
+        , creditAvailable(epicsEventEmpty)
         , workerShutdown(false)
         , consumer(consumer)
         , sleep(sleep)
@@ -112,6 +204,7 @@ public:
     {
         workerShutdown = true;
         workToDo.signal();
+        creditAvailable.signal();
         worker.exitWait();
     }
 
@@ -131,16 +224,17 @@ public:
     void pushRequest(std::shared_ptr<T> cargo,
                      const menuPriority priority)
     {
-        Guard G(lock[priority]);
-        queue[priority].push(cargo);
-        workToDo.signal();
+        if (queue[priority].push(std::move(cargo)) || batchReady())
+            workToDo.signal();
+        if (priority == menuPriorityHIGH && expressLane)
+            signalExpress();
     }
 
     /**
      * @brief Pushes a vector of requests to the appropriate queue.
      *
      * Pushes the cargo to the appropriate queue and signals the worker thread.
-     * Keeps the queue locked during the push operation (so that all requests may be
+     * The requests are appended as one contiguous chain (so that all requests may be
      * handed to the worker at one time).
      *
      * @param cargo  vector of shared_ptr to the request
@@ -149,10 +243,10 @@ public:
     void pushRequest(std::vector<std::shared_ptr<T>> &cargo,
                      const menuPriority priority)
     {
-        Guard G(lock[priority]);
-        for (auto it : cargo)
-            queue[priority].push(it);
-        workToDo.signal();
+        if (queue[priority].push(cargo) || batchReady())
+            workToDo.signal();
+        if (priority == menuPriorityHIGH && expressLane)
+            signalExpress();
     }
 
     /**
@@ -177,14 +271,209 @@ public:
 
     /**
      * @brief Clears all queues (removing all unprocessed requests).
+     *
+     * Also resets the number of outstanding batches (as after a connection loss
+     * no completions are to be expected) and starts a new generation of batches,
+     * i.e. completions of batches delivered before are ignored.
      */
     void clear() {
-        for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW; prio--) {
-            Guard G(lock[prio]);
-            while (!queue[prio].empty()) {
-                queue[prio].pop();
-            }
+        {
+            Guard G(drainLock);
+            for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW; prio--)
+                queue[prio].clear();
         }
+        Guard G(paramLock);
+        outstanding = 0;
+        generation++;
+        creditAvailable.signal();
+    }
+
+    /**
+     * @brief Enables or disables the express lane for HIGH priority requests.
+     *
+     * @param enable  `true` = send HIGH priority requests immediately
+     */
+    void setExpress(const bool enable)
+    {
+        expressLane = enable;
+        if (enable)
+            signalExpress();
+    }
+
+    /**
+     * @brief Get express lane parameter.
+     * @return `true` if the express lane is enabled
+     */
+    bool getExpress() const { return expressLane; }
+
+    /**
+     * @brief Get the number of batches that were sent through the express lane.
+     * @return number of express batches
+     */
+    unsigned long noOfExpressBatches() const {
+        Guard G(drainLock);
+        return expressBatches;
+    }
+
+    /**
+     * @brief Get the average time express requests spent in the queue.
+     *
+     * Covers all HIGH priority requests dequeued while the express lane is enabled,
+     * whether sent in an express batch or picked up by a regular batch.
+     *
+     * @return average wait time [msec]
+     */
+    double averageExpressWait() const {
+        Guard G(drainLock);
+        return expressStats.count ? expressStats.total * 1e3 / expressStats.count : 0.0;
+    }
+
+    /**
+     * @brief Get the maximum time an express request spent in the queue.
+     * @return maximum wait time [msec]
+     */
+    double maxExpressWait() const {
+        Guard G(drainLock);
+        return expressStats.max * 1e3;
+    }
+
+    /**
+     * @brief Sets the age limit for deadline-driven batching.
+     *
+     * A non-zero age limit makes the worker hold back a partial batch until it can
+     * be filled or the oldest queued request has waited for the age limit.
+     *
+     * @param limit  max. time a request is held back to fill a batch [msec], 0 = send immediately
+     */
+    void setAgeLimit(const unsigned int limit)
+    {
+        ageLimit = limit / 1e3;
+        workToDo.signal();
+    }
+
+    /**
+     * @brief Get age limit parameter.
+     * @return current age limit [msec], 0 = no holding back
+     */
+    unsigned int getAgeLimit() const { return static_cast<unsigned int>(ageLimit * 1e3); }
+
+    /**
+     * @brief Sets the weights for weighted (deficit round robin) scheduling.
+     *
+     * All weights 0 selects strict priority scheduling (default).
+     * Otherwise, weights are used as quanta of the deficit round robin scheme,
+     * with a weight of 0 being treated as 1.
+     *
+     * @param weights  array of weights, indexed by EPICS priority (0=low, 1=mid, 2=high)
+     */
+    void setWeights(const unsigned int (&weights)[menuPriority_NUM_CHOICES])
+    {
+        Guard G(drainLock);
+        weighted = false;
+        for (int prio = menuPriorityLOW; prio < menuPriority_NUM_CHOICES; prio++) {
+            if (weights[prio])
+                weighted = true;
+            weight[prio] = std::max(1u, weights[prio]);
+            deficit[prio] = 0;
+        }
+        drrPrio = menuPriorityHIGH;
+        drrCredited = false;
+    }
+
+    /**
+     * @brief Get the scheduling weight of a priority.
+     * @param priority  EPICS priority (0=low, 1=mid, 2=high)
+     * @return weight, 0 = strict priority scheduling
+     */
+    unsigned int getWeight(const menuPriority priority) const { return weighted ? weight[priority] : 0; }
+
+    /**
+     * @brief Get the number of requests that were taken from a queue.
+     * @param priority  EPICS priority (0=low, 1=mid, 2=high)
+     * @return number of requests
+     */
+    unsigned long dequeued(const menuPriority priority) const {
+        Guard G(drainLock);
+        return waitStats[priority].count;
+    }
+
+    /**
+     * @brief Get the average time requests spent in a queue.
+     * @param priority  EPICS priority (0=low, 1=mid, 2=high)
+     * @return average wait time [msec]
+     */
+    double averageWait(const menuPriority priority) const {
+        Guard G(drainLock);
+        return waitStats[priority].count ? waitStats[priority].total * 1e3 / waitStats[priority].count : 0.0;
+    }
+
+    /**
+     * @brief Get the maximum time a request spent in a queue.
+     * @param priority  EPICS priority (0=low, 1=mid, 2=high)
+     * @return maximum wait time [msec]
+     */
+    double maxWait(const menuPriority priority) const {
+        Guard G(drainLock);
+        return waitStats[priority].max * 1e3;
+    }
+
+    /**
+     * @brief Resets the wait time statistics of all queues.
+     */
+    void resetWaitStats() {
+        Guard G(drainLock);
+        for (auto &ws : waitStats)
+            ws = WaitStats();
+    }
+
+    /**
+     * @brief Sets the window of outstanding batches.
+     *
+     * A non-zero window limits the number of batches that have been delivered to the
+     * consumer but not reported back through completeBatch(). In that mode, no
+     * hold-off time is applied.
+     *
+     * @param window  max. number of outstanding batches, 0 = no limit (use hold-off)
+     */
+    void setWindow(const unsigned int window)
+    {
+        Guard G(paramLock);
+        maxOutstanding = window;
+        creditAvailable.signal();
+    }
+
+    /**
+     * @brief Get the generation of the batch being delivered.
+     *
+     * To be called by the consumer from processRequests(), and passed
+     * to completeBatch() when the batch is completed.
+     *
+     * @return generation of the (last) delivered batch
+     */
+    unsigned int batchGeneration() const
+    {
+        Guard G(paramLock);
+        return deliveredGeneration;
+    }
+
+    /**
+     * @brief Reports the completion of a delivered batch.
+     *
+     * Must be called by the consumer once for every delivered batch,
+     * when its service call has completed or failed (or was not issued).
+     * Returns a credit to the window, unless the batch was delivered
+     * before the last clear().
+     *
+     * @param batchGeneration  generation of the batch (see batchGeneration())
+     */
+    void completeBatch(const unsigned int batchGeneration)
+    {
+        Guard G(paramLock);
+        if (batchGeneration != generation)
+            return;
+        if (outstanding)
+            outstanding--;
+        creditAvailable.signal();
     }
 
     /**
@@ -204,6 +493,159 @@ public:
             holdOffVar = maxHoldOff ? (static_cast<double>(maxHoldOff) - minHoldOff) / (maxRequestsPerBatch * 1e3)
                                     : 0.0;
         holdOffFix = minHoldOff / 1e3;
+        resetAdaptive();
+    }
+
+    /**
+     * @brief Attaches rate limiters (token buckets).
+     *
+     * The buckets are not owned by the batcher and must outlive it.
+     *
+     * @param calls  bucket for service calls (one token per batch), nullptr = none
+     * @param nodes  bucket for nodes (one token per request), nullptr = none
+     */
+    void setRateLimiters(TokenBucket *calls, TokenBucket *nodes)
+    {
+        Guard G(paramLock);
+        callLimiter = calls;
+        nodeLimiter = nodes;
+    }
+
+    /** number of successful full batches before a learned cap is relaxed */
+    static const unsigned int capRelaxBatches = 100;
+
+    /**
+     * @brief Sets a cap on the number of requests per batch.
+     *
+     * Used by the consumer to apply a limit that it has learned at runtime
+     * (e.g. from the server rejecting batches that are too large).
+     * The cap applies on top of maxRequestsPerBatch and the adaptive batch size.
+     * It is relaxed step by step after capRelaxBatches successful full batches
+     * (see reportSuccess()).
+     *
+     * @param cap  max. number of requests per batch, 0 = no cap
+     */
+    void setRequestsCap(const unsigned int cap)
+    {
+        Guard G(paramLock);
+        requestsCap = cap;
+        capSuccesses = 0;
+    }
+
+    /**
+     * @brief Reports the successful completion of a batch.
+     *
+     * Used to relax a learned cap (see setRequestsCap()): after capRelaxBatches
+     * consecutive successful batches that were limited by the cap, the cap is raised
+     * by an eighth (at least one request). It is removed when it reaches maxRequestsPerBatch.
+     * Smaller batches are not counted.
+     *
+     * @param batchSize  number of requests in the batch
+     */
+    void reportSuccess(const size_t batchSize)
+    {
+        Guard G(paramLock);
+        const unsigned int cap = requestsCap;
+        if (!cap || batchSize < cap)
+            return;
+        if (++capSuccesses < capRelaxBatches)
+            return;
+        capSuccesses = 0;
+        unsigned int relaxed = cap + std::max(1u, cap / 8);
+        const unsigned int configured = maxBatchSize;
+        if (configured && relaxed >= configured)
+            relaxed = 0;
+        requestsCap = relaxed;
+    }
+
+    /**
+     * @brief Get the cap on the number of requests per batch.
+     * @return current cap, 0 = no cap
+     */
+    unsigned int getRequestsCap() const { return requestsCap; }
+
+    /**
+     * @brief Sets the byte budget for batches.
+     *
+     * A non-zero budget limits the sum of the request costs (as reported by the
+     * consumer through requestCost()) in every batch, in addition to the
+     * limit of requests per batch.
+     *
+     * @param bytes  max. cost of a batch [bytes], 0 = no limit
+     */
+    void setMaxBytes(const size_t bytes)
+    {
+        Guard G(paramLock);
+        maxBatchBytes = bytes;
+    }
+
+    /**
+     * @brief Get byte budget parameter.
+     * @return current limit for the cost of a batch [bytes], 0 = no limit
+     */
+    size_t maxBytes() const { return maxBatchBytes; }
+
+    /**
+     * @brief Get the number of batches that were closed by the byte budget.
+     * @return number of batches
+     */
+    unsigned long budgetLimitedBatches() const {
+        Guard G(drainLock);
+        return budgetLimited;
+    }
+
+    /**
+     * @brief Sets the latency target for adaptive mode.
+     *
+     * A non-zero target switches the batcher to adaptive mode, where the
+     * batch size (up to maxRequestsPerBatch) and the hold-off time (between minimal
+     * holdoff and the larger of maximal holdoff and the target) are adjusted based
+     * on the latencies reported through reportLatency().
+     *
+     * @param target  latency target [msec], 0 = static parameters (no adaptation)
+     */
+    void setLatencyTarget(const unsigned int target)
+    {
+        Guard G(paramLock);
+        latencyTarget = target / 1e3;
+        resetAdaptive();
+    }
+
+    /**
+     * @brief Reports the measured round trip time of a delivered batch.
+     *
+     * Called by the consumer when the service call for a batch has completed.
+     * Drives the AIMD controller in adaptive mode; always updates the
+     * average latency (for statistics).
+     *
+     * @param latency  round trip time of the service call [sec]
+     * @param batchSize  number of requests in the batch
+     */
+    void reportLatency(const double latency, const size_t batchSize)
+    {
+        Guard G(paramLock);
+        latencyAvg = latencyAvg > 0.0 ? latencyAvg + (latency - latencyAvg) / 8.0 : latency;
+        if (latencyTarget <= 0.0 || !batchSize)
+            return;
+
+        const double step = 1e-3; // hold-off increment [sec]
+        double holdOffLimit = std::max(holdOffFix + holdOffVar * maxBatchSize, latencyTarget);
+        if (latency > latencyTarget) {
+            // Multiplicative decrease (ignoring batches sent before the last decrease)
+            if (!adaptiveMax || batchSize <= adaptiveMax) {
+                adaptiveMax = std::max<unsigned int>(1u, static_cast<unsigned int>(batchSize) / 2);
+                adaptiveHoldOff = std::min(std::max(2.0 * adaptiveHoldOff, step), holdOffLimit);
+            }
+        } else {
+            // Additive increase (only when the limit was actually hit)
+            adaptiveHoldOff = std::max(adaptiveHoldOff - step, holdOffFix);
+            if (adaptiveMax && batchSize >= adaptiveMax) {
+                const unsigned int configured = maxBatchSize;
+                adaptiveMax += std::max<unsigned int>(1u, (configured ? configured : adaptiveMax) / 32);
+                if (configured && adaptiveMax > configured)
+                    adaptiveMax = configured;
+            }
+        }
     }
 
     /**
@@ -226,60 +668,421 @@ public:
         return static_cast<unsigned int>((holdOffFix + holdOffVar * maxBatchSize) * 1e3);
     }
 
+    /**
+     * @brief Get window parameter.
+     * @return max. number of outstanding batches, 0 = no limit
+     */
+    unsigned int window() const { return maxOutstanding; }
+
+    /**
+     * @brief Get the number of outstanding (delivered, not completed) batches.
+     * @return number of outstanding batches
+     */
+    unsigned int outstandingBatches() const {
+        Guard G(paramLock);
+        return outstanding;
+    }
+
+    /**
+     * @brief Get latency target parameter.
+     * @return current latency target [msec], 0 = adaptive mode off
+     */
+    unsigned int latencyTargetMs() const { return static_cast<unsigned int>(latencyTarget * 1e3); }
+
+    /**
+     * @brief Get the batch size limit that is currently applied.
+     * @return current limit for requests per batch (0 = no limit)
+     */
+    unsigned int currentMaxRequests() const {
+        Guard G(paramLock);
+        return batchLimit();
+    }
+
+    /**
+     * @brief Get the hold-off time that is currently applied in adaptive mode.
+     * @return current adaptive holdoff time [msec]
+     */
+    double currentHoldOff() const {
+        Guard G(paramLock);
+        return adaptiveHoldOff * 1e3;
+    }
+
+    /**
+     * @brief Get the (exponentially weighted) average service round trip time.
+     * @return average latency [msec]
+     */
+    double averageLatency() const {
+        Guard G(paramLock);
+        return latencyAvg * 1e3;
+    }
+
     // epicsThreadRunable API
     // Worker thread body
     virtual void run () override {
         do {
             double holdOff;
             unsigned int max;
+            size_t budget;
 
             workToDo.wait();
             if (workerShutdown) break;
 
-            { // Scope for cargo vector
-                std::vector<std::shared_ptr<T>> batch;
+            { // Window mode: wait for a credit (completion of an outstanding batch)
+                Guard G(paramLock);
+                while (maxOutstanding && outstanding >= maxOutstanding && !workerShutdown) {
+                    UnGuard U(G);
+                    if (expressPending())
+                        sendExpress();
+                    else
+                        creditAvailable.wait();
+                }
+            }
+            if (workerShutdown) break;
 
-                { // Scope for parameter guard
-                    Guard G(paramLock);
-                    max = maxBatchSize;
+            { // Scope for parameter guard
+                Guard G(paramLock);
+                max = batchLimit();
+                budget = maxBatchBytes;
+            }
+
+            // Deadline mode: hold back a partial batch until full or oldest request too old
+            double limit;
+            while ((limit = ageLimit) > 0.0 && !workerShutdown) {
+                size_t queued = 0;
+                epicsTime oldest = epicsTime::getCurrent();
+                { // Scope for drain guard
+                    Guard G(drainLock);
+                    for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW; prio--) {
+                        epicsTime t;
+                        queued += queue[prio].size();
+                        if (queue[prio].frontTime(t) && t < oldest)
+                            oldest = t;
+                    }
                 }
+                if (!queued || (max && queued >= max) || expressPending())
+                    break;
+                double age = epicsTime::getCurrent() - oldest;
+                if (age >= limit)
+                    break;
+                workToDo.wait(limit - age);
+            }
+            if (workerShutdown) break;
 
-                // Plain priority queue algorithm (for the time being)
-                for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW; prio--) {
-                    if (!max || batch.size() < max) {
-                        Guard G(lock[prio]);
-                        while (queue[prio].size() && (!max || batch.size() < max)) {
-                            batch.emplace_back(std::move(queue[prio].front()));
-                            queue[prio].pop();
+            { // Scope for the batch contents (buffer is reused, references are dropped)
+                // Producers only signal when a queue goes from empty to non-empty,
+                // so the worker has to re-signal itself while work is left over.
+                bool leftOver = false;
+                { // Scope for drain guard
+                    Guard G(drainLock);
+                    fillBatch(max, budget);
+                    for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW; prio--) {
+                        if (!queue[prio].empty()) {
+                            leftOver = true;
+                            break;
                         }
                     }
-                    if (!queue[prio].empty())
-                        workToDo.signal();
+                }
+                if (leftOver) {
+                    // A request that is counted but not yet linked in by its producer
+                    // cannot be taken: yield to the producer instead of spinning
+                    if (batch.empty())
+                        epicsThread::sleep(0.0);
+                    workToDo.signal();
                 }
 
-                if (!batch.empty())
+                if (!batch.empty()) {
+                    double wait = 0.0;
+                    { // Scope for parameter guard
+                        Guard G(paramLock);
+                        if (callLimiter)
+                            wait = callLimiter->take(1);
+                        if (nodeLimiter)
+                            wait = std::max(wait, nodeLimiter->take(static_cast<double>(batch.size())));
+                    }
+                    if (wait > 0.0)
+                        sleep(wait);
+                    { // Scope for parameter guard
+                        Guard G(paramLock);
+                        outstanding++;
+                        deliveredGeneration = generation;
+                    }
                     consumer.processRequests(batch);
+                }
 
                 { // Scope for parameter guard
                     Guard G(paramLock);
-                    holdOff = holdOffFix + holdOffVar * batch.size();
+                    if (maxOutstanding)
+                        holdOff = 0.0;
+                    else if (latencyTarget > 0.0)
+                        holdOff = adaptiveHoldOff;
+                    else
+                        holdOff = holdOffFix + holdOffVar * batch.size();
                 }
+                batch.clear();
             }
 
-            if (holdOff > 0.0)
-                sleep(holdOff);
+            if (holdOff > 0.0) {
+                if (expressLane)
+                    holdOffExpress(holdOff);
+                else
+                    sleep(holdOff);
+            }
 
         } while (true);
     }
 
 private:
-    epicsMutex lock[menuPriority_NUM_CHOICES];
-    std::queue<std::shared_ptr<T>> queue[menuPriority_NUM_CHOICES];
-    epicsMutex paramLock;
-    unsigned maxBatchSize;
+    struct WaitStats {
+        WaitStats() : count(0), total(0.0), max(0.0) {}
+        unsigned long count;   // number of dequeued requests
+        double total;          // sum of wait times [sec]
+        double max;            // max. wait time [sec]
+    };
+
+    // Take one request from a queue, accounting its wait time and cost (drainLock must be held)
+    // Returns false (setting budgetExhausted) if the request does not fit into the byte budget
+    bool take(const int prio, std::shared_ptr<T> &cargo, const epicsTime &now, const size_t budget)
+    {
+        size_t cost = 0;
+        if (budget) {
+            const T *next = queue[prio].front();
+            if (!next)
+                return false;
+            cost = consumer.requestCost(*next);
+            if (batchCount && batchBytes + cost > budget) {
+                budgetExhausted = true;
+                return false;
+            }
+        }
+        epicsTime enqueued;
+        if (!queue[prio].pop(cargo, enqueued))
+            return false;
+        batchCount++;
+        batchBytes += cost;
+        account(waitStats[prio], now - enqueued);
+        if (prio == menuPriorityHIGH && expressLane)
+            account(expressStats, now - enqueued);
+        return true;
+    }
+
+    // Account one wait time in statistics (drainLock must be held)
+    static void account(WaitStats &ws, const double wait)
+    {
+        ws.count++;
+        ws.total += wait;
+        if (wait > ws.max)
+            ws.max = wait;
+    }
+
+    // Current limit for requests per batch (paramLock must be held)
+    unsigned int batchLimit() const
+    {
+        unsigned int max = latencyTarget > 0.0 ? adaptiveMax : maxBatchSize.load();
+        const unsigned int cap = requestsCap;
+        if (cap && (!max || max > cap))
+            max = cap;
+        return max;
+    }
+
+    // Wake up the worker from any waiting state
+    void signalExpress()
+    {
+        workToDo.signal();
+        creditAvailable.signal();
+    }
+
+    // Express lane: true if HIGH priority requests are waiting
+    bool expressPending() const { return expressLane && !queue[menuPriorityHIGH].empty(); }
+
+    // Express lane: send all queued HIGH priority requests in minimal batch(es)
+    void sendExpress()
+    {
+        unsigned int max;
+        size_t budget;
+        { // Scope for parameter guard
+            Guard G(paramLock);
+            max = batchLimit();
+            budget = maxBatchBytes;
+        }
+        while (expressPending() && !workerShutdown) {
+            { // Scope for drain guard
+                Guard G(drainLock);
+                std::shared_ptr<T> cargo;
+                epicsTime now = epicsTime::getCurrent();
+                batchCount = 0;
+                batchBytes = 0;
+                budgetExhausted = false;
+                while ((!max || batch.size() < max) && take(menuPriorityHIGH, cargo, now, budget))
+                    batch.emplace_back(std::move(cargo));
+                if (budgetExhausted)
+                    budgetLimited++;
+                if (!batch.empty())
+                    expressBatches++;
+            }
+            if (batch.empty())
+                break;
+            double wait = 0.0;
+            { // Scope for parameter guard
+                Guard G(paramLock);
+                if (callLimiter)
+                    wait = callLimiter->take(1);
+                if (nodeLimiter)
+                    wait = std::max(wait, nodeLimiter->take(static_cast<double>(batch.size())));
+            }
+            if (wait > 0.0)
+                sleep(wait);
+            { // Scope for parameter guard
+                Guard G(paramLock);
+                outstanding++;
+                deliveredGeneration = generation;
+            }
+            consumer.processRequests(batch);
+            batch.clear();
+        }
+    }
+
+    // Express lane: hold-off that is interrupted for sending express requests
+    void holdOffExpress(const double holdOff)
+    {
+        epicsTime end = epicsTime::getCurrent() + holdOff;
+        double remaining;
+        while (!workerShutdown && (remaining = end - epicsTime::getCurrent()) > 0.0) {
+            workToDo.wait(remaining);
+            if (expressPending())
+                sendExpress();
+        }
+        // Wake-ups (for regular requests or shutdown) were consumed while waiting
+        if (workerShutdown) {
+            workToDo.signal();
+            return;
+        }
+        for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW; prio--) {
+            if (!queue[prio].empty()) {
+                workToDo.signal();
+                break;
+            }
+        }
+    }
+
+    // Deadline mode: true if enough requests for a full batch are queued
+    // (called by producers without holding paramLock: only reads atomic parameters)
+    bool batchReady() const
+    {
+        if (ageLimit <= 0.0)
+            return false;
+        unsigned int max = maxBatchSize; // (adaptive limit is lower: woken up by age limit)
+        const unsigned int cap = requestsCap;
+        if (cap && (!max || max > cap))
+            max = cap;
+        size_t queued = 0;
+        for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW; prio--)
+            queued += queue[prio].size();
+        return max && queued >= max;
+    }
+
+    // Collect the next batch of up to max requests (and budget bytes)
+    // into the batch buffer (drainLock must be held)
+    void fillBatch(const unsigned int max, const size_t budget)
+    {
+        std::shared_ptr<T> cargo;
+        epicsTime now = epicsTime::getCurrent();
+        batchCount = 0;
+        batchBytes = 0;
+        budgetExhausted = false;
+
+        if (!weighted) {
+            // Plain priority queue algorithm
+            for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW && !budgetExhausted; prio--) {
+                while ((!max || batch.size() < max) && take(prio, cargo, now, budget))
+                    batch.emplace_back(std::move(cargo));
+            }
+            if (budgetExhausted)
+                budgetLimited++;
+            return;
+        }
+
+        // Deficit round robin (all requests having a quantum cost of 1)
+        // The round (current priority and deficits) continues across batches,
+        // so that a batch limit below the HIGH weight cannot starve the lower priorities.
+        size_t n = 0;
+        unsigned idle = 0; // consecutive priorities visited without taking a request
+        while (idle < menuPriority_NUM_CHOICES && (!max || n < max)) {
+            const int prio = drrPrio;
+            bool took = false;
+            if (!drrCredited) {
+                // cap, so that a deficit left over from an interrupted visit cannot accumulate
+                deficit[prio] = std::min(deficit[prio] + weight[prio], weight[prio] + max);
+                drrCredited = true;
+            }
+            while (deficit[prio] && (!max || n < max) && take(prio, cargo, now, budget)) {
+                deficit[prio]--;
+                part[prio].emplace_back(std::move(cargo));
+                n++;
+                took = true;
+            }
+            if (budgetExhausted)
+                break;                // continue this visit with the next batch
+            if (deficit[prio] && !queue[prio].empty() && max && n >= max)
+                break;                // continue this visit with the next batch
+            if (queue[prio].empty())
+                deficit[prio] = 0;
+            drrPrio = prio == menuPriorityLOW ? menuPriority_NUM_CHOICES-1 : prio - 1;
+            drrCredited = false;
+            idle = took ? 0 : idle + 1;
+        }
+        for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW; prio--) {
+            for (auto &c : part[prio])
+                batch.emplace_back(std::move(c));
+            part[prio].clear();
+        }
+        if (budgetExhausted)
+            budgetLimited++;
+    }
+
+    // Start adaptation from the static configuration (paramLock must be held)
+    void resetAdaptive()
+    {
+        adaptiveMax = maxBatchSize;
+        adaptiveHoldOff = holdOffFix;
+        latencyAvg = 0.0;
+    }
+
+    MpscQueue<T> queue[menuPriority_NUM_CHOICES];
+    mutable epicsMutex drainLock;
+    mutable epicsMutex paramLock;
+    std::atomic<unsigned> maxBatchSize;   // limit of requests per batch (0 = no limit)
     double holdOffVar, holdOffFix;
+    double latencyTarget, latencyAvg;     // adaptive mode: target and average latency [sec]
+    unsigned adaptiveMax;                 // adaptive mode: current batch size limit
+    double adaptiveHoldOff;               // adaptive mode: current hold-off [sec]
+    std::atomic<unsigned> requestsCap;    // learned cap for requests per batch (0 = no cap)
+    unsigned capSuccesses;                // successful full batches since the cap was last changed
+    size_t maxBatchBytes;                 // byte budget per batch (0 = no limit)
+    size_t batchBytes;                    // cost of the batch being filled
+    size_t batchCount;                    // number of requests in the batch being filled
+    bool budgetExhausted;                 // batch being filled was closed by the byte budget
+    unsigned long budgetLimited;          // number of batches closed by the byte budget
+    TokenBucket *callLimiter;             // rate limiter for service calls (not owned)
+    TokenBucket *nodeLimiter;             // rate limiter for nodes (not owned)
+    unsigned maxOutstanding;              // window mode: max. number of outstanding batches
+    unsigned outstanding;                 // number of delivered, not completed batches
+    unsigned generation;                  // current generation of batches (advanced by clear())
+    unsigned deliveredGeneration;         // generation of the last delivered batch
+    std::atomic<double> ageLimit;         // deadline mode: max. hold back time [sec]
+    std::atomic<bool> expressLane;        // express lane for HIGH priority requests
+    unsigned long expressBatches;         // number of express batches
+    WaitStats expressStats;               // HIGH requests wait time statistics (while express lane is on)
+    bool weighted;                        // weighted (deficit round robin) scheduling
+    unsigned weight[menuPriority_NUM_CHOICES];   // DRR: quantum per priority
+    unsigned deficit[menuPriority_NUM_CHOICES];  // DRR: deficit counter per priority
+    int drrPrio;                          // DRR: priority being served (kept across batches)
+    bool drrCredited;                     // DRR: quantum of drrPrio already credited
+    WaitStats waitStats[menuPriority_NUM_CHOICES]; // queue wait time statistics per priority
+    std::vector<std::shared_ptr<T>> batch;                      // batch buffer (reused)
+    std::vector<std::shared_ptr<T>> part[menuPriority_NUM_CHOICES]; // DRR: per priority buffers (reused)
     epicsThread worker;
     epicsEvent workToDo;
+    epicsEvent creditAvailable;
     bool workerShutdown;
     RequestConsumer<T> &consumer;
     void (*sleep)(double);
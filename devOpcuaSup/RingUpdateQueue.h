@@ -0,0 +1,600 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#ifndef DEVOPCUA_RINGUPDATEQUEUE_H
+#define DEVOPCUA_RINGUPDATEQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#include <epicsMutex.h>
+#include <epicsTime.h>
+
+#include "devOpcua.h"
+
+namespace DevOpcua {
+
+/**
+ * @class ClientQueueBudget
+ * @brief Global memory budget for all (adaptive) client side update queues.
+ *
+ * Queues account for the memory of their slots (estimated) when they are
+ * created, grow or shrink. Growing an adaptive queue fails when it would
+ * exceed the budget.
+ */
+class ClientQueueBudget
+{
+public:
+    /**
+     * @brief Sets the budget.
+     * @param bytes  memory budget [bytes], 0 = no limit
+     */
+    static void setLimit(const size_t bytes) { limit().store(bytes); }
+
+    /**
+     * @brief Get the budget.
+     * @return  memory budget [bytes], 0 = no limit
+     */
+    static size_t getLimit() { return limit().load(); }
+
+    /**
+     * @brief Get the memory in use by all queues.
+     * @return  accounted memory [bytes]
+     */
+    static size_t inUse() { return used().load(); }
+
+    /**
+     * @brief Reserves memory (if within the budget).
+     * @param bytes  memory to reserve [bytes]
+     * @param force  reserve even if over budget
+     * @return  `true` if reserved, `false` if over budget
+     */
+    static bool reserve(const size_t bytes, const bool force = false)
+    {
+        size_t u = used().load();
+        do {
+            const size_t l = limit().load();
+            if (!force && l && u + bytes > l)
+                return false;
+        } while (!used().compare_exchange_weak(u, u + bytes));
+        return true;
+    }
+
+    /**
+     * @brief Releases reserved memory.
+     * @param bytes  memory to release [bytes]
+     */
+    static void release(const size_t bytes) { used().fetch_sub(bytes); }
+
+private:
+    static std::atomic<size_t> &limit() { static std::atomic<size_t> l(0); return l; }
+    static std::atomic<size_t> &used() { static std::atomic<size_t> u(0); return u; }
+};
+
+/**
+ * @brief A fixed size ring buffer for handling incoming updates (data and events).
+ *
+ * Drop-in replacement for UpdateQueue with the same interface and semantics:
+ * when updates are pushed to a full queue, either the front or the back update
+ * on the queue (depending on the queue's discard policy) are dropped
+ * and the overrides counter of the following update is stepped up.
+ *
+ * The slots are preallocated. The consumer side (popUpdate) never takes a lock.
+ * Producers are serialized by a lock that the consumer never takes, so that
+ * the usual case (one client library thread pushing, one record processing
+ * thread popping) is free of contention.
+ *
+ * Ownership of a slot is transferred through its sequence number (as in D. Vyukov's
+ * bounded queue): a slot for position p is free when its sequence is p, holds
+ * an update when it is p+1, and is claimed (by the consumer popping it, or by a
+ * producer dropping or overriding it) while it is `busy`.
+ *
+ * When the front update is dropped while the consumer is popping, the carried
+ * over overrides are added to the next update that the consumer pops.
+ *
+ * A queue of size 1 is a conflating slot that only keeps the latest update
+ * (the result is the same for both discard policies). It is implemented as
+ * a triple buffer with an atomic index swap: popUpdate is wait-free and never
+ * takes a lock. As a Data Element is fed by several client library threads
+ * (data changes, read completions, connection events), producers are still
+ * serialized by the producer lock.
+ * Overrides are carried over to the next update that the consumer pops; if the
+ * consumer pops the newer update before the producer counted the dropped one,
+ * the override shows up on the following update.
+ *
+ * With a maximum age, data updates that have been waiting in the queue
+ * for longer than that (measured from the time they were pushed, i.e.
+ * the client side time stamp) are dropped when popping, as long as there
+ * is a newer update behind them. The overrides are carried over as usual.
+ * This way the consumer catches up after a stall without working through
+ * all the stale values.
+ *
+ * In adaptive mode (see setAdaptive), the consumer grows the queue (by doubling)
+ * after updates were dropped, and shrinks it (by halving) when the fill level
+ * stayed low for a while, within the configured bounds and the global
+ * ClientQueueBudget. Resizing takes the producer lock for a moment.
+ * The conflating slot (size 1) is never resized.
+ *
+ * The template parameter T is expected to be an instance of the Update class,
+ * i.e. it must provide the override(), getOverrides() and getType() methods.
+ */
+template<typename T>
+class RingUpdateQueue
+{
+    struct Slot {
+        std::atomic<size_t> seq;
+        std::shared_ptr<T> update;
+        epicsTime pushed;
+    };
+
+public:
+    /**
+     * @brief Construct a queue.
+     *
+     * @param size  max. number of elements
+     * @param discardOldest  `true` = drop oldest update when full, `false` = drop newest
+     * @param maxAge  max. age of data updates when popping [sec], 0 = no limit
+     */
+    RingUpdateQueue(const size_t size, const bool discardOldest = true, const double maxAge = 0.0)
+        : maxElements(size)
+        , conflating(size == 1)
+        , noOfSlots(conflating ? 3 : (size ? size : 1))
+        , discardOldest(discardOldest)
+        , maxAge(conflating ? 0.0 : maxAge)
+        , slots(new Slot[noOfSlots])
+        , head(0)
+        , tail(0)
+        , count(0)
+        , carried(0)
+        , dropped(0)
+        , expired(0)
+        , highWater(0)
+        , latest(1)
+        , back(0)
+        , front(2)
+        , minAdaptive(0)
+        , maxAdaptive(0)
+        , windowHigh(0)
+        , windowPops(0)
+        , droppedSeen(0)
+        , resizes(0)
+    {
+        for (size_t i = 0; i < noOfSlots; i++)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+        ClientQueueBudget::reserve(noOfSlots * slotBytes, true);
+    }
+
+    ~RingUpdateQueue() { ClientQueueBudget::release(noOfSlots * slotBytes); }
+
+    RingUpdateQueue(const RingUpdateQueue &) = delete;
+    RingUpdateQueue &operator=(const RingUpdateQueue &) = delete;
+
+    /**
+     * @brief Inserts an update at the end.
+     *
+     * Pushes the given update to the end of the queue.
+     *
+     * @param update  the update to push
+     * @param[out] wasFirst  `true` if pushed element was the first one, `false` otherwise
+     */
+    void pushUpdate(std::shared_ptr<T> update, bool *wasFirst = nullptr)
+    {
+        if (conflating) {
+            pushLatest(std::move(update), wasFirst);
+            return;
+        }
+        Guard G(producerLock);
+        if (wasFirst) *wasFirst = false;
+        if (!maxElements)
+            return;
+        const size_t t = tail;
+        Slot &s = slot(t);
+        for (;;) {
+            if (s.seq.load() == t) {
+                // Free slot: publish the update, then count it
+                s.update = std::move(update);
+                if (maxAge > 0.0)
+                    s.pushed = epicsTime::getCurrent();
+                s.seq.store(t + 1);
+                tail = t + 1;
+                const size_t n = count.fetch_add(1);
+                if (n == 0 && wasFirst)
+                    *wasFirst = true;
+                if (n + 1 > highWater.load())
+                    highWater.store(n + 1);
+                if (n + 1 > windowHigh.load())
+                    windowHigh.store(n + 1);
+                return;
+            }
+            if (count.load() == maxElements) {
+                // Full queue: drop one update, the number of elements does not change
+                if (discardOldest ? replaceFront(update, t) : replaceBack(*update, t))
+                    return;
+            }
+            // Consumer is freeing a slot
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief Removes an update from the front.
+     *
+     * Removes an update from the front of the queue and returns it.
+     *
+     * Calling popUpdate on an empty queue is undefined.
+     *
+     * @param[out] nextReason  ProcessReason of the next element, `none` if last element
+     *
+     * @return  reference to the removed update
+     */
+    std::shared_ptr<T> popUpdate(ProcessReason *nextReason = nullptr)
+    {
+        if (conflating)
+            return popLatest(nextReason);
+        epicsTime pushed;
+        size_t remaining;
+        std::shared_ptr<T> upd = popFront(pushed, remaining);
+        if (maxAge > 0.0 && remaining) {
+            // Drop stale data updates that have a newer one behind them
+            const epicsTime now = epicsTime::getCurrent();
+            for (size_t n = 1; n < noOfSlots && remaining
+                 && upd->getType() == ProcessReason::incomingData
+                 && now - pushed > maxAge; n++) {
+                std::shared_ptr<T> newer = popFront(pushed, remaining);
+                newer->override(upd->getOverrides());
+                expired.fetch_add(1);
+                upd = std::move(newer);
+            }
+        }
+        if (maxAdaptive)
+            adapt();
+        if (nextReason) {
+            if (!remaining) *nextReason = ProcessReason::none;
+            else *nextReason = peekType();
+        }
+        return upd;
+    }
+
+    /**
+     * @brief Switches the queue to adaptive sizing.
+     *
+     * Must be called before the queue is used.
+     * Has no effect on a queue of size 0 or 1 (conflating slot).
+     *
+     * @param minSize  lower bound for the queue size
+     * @param maxSize  upper bound for the queue size
+     */
+    void setAdaptive(const size_t minSize, const size_t maxSize)
+    {
+        if (conflating || !maxElements.load())
+            return;
+        minAdaptive = std::max<size_t>(minSize, 2);
+        maxAdaptive = std::max(maxSize, minAdaptive);
+    }
+
+    /**
+     * @brief Returns the number of adaptive resizes.
+     *
+     * @return  number of times the queue grew or shrank
+     */
+    unsigned long noOfResizes() const { return resizes.load(); }
+
+    /**
+     * @brief Removes a run of data updates from the front, returning the newest.
+     *
+     * Batch drain: if the front update and the ones behind it are incoming data,
+     * they are popped together (at most one queue length), and the newest one
+     * is returned with the dropped ones counted as overrides.
+     * Other types of updates (e.g. connection loss) end the run and are kept.
+     *
+     * Calling popDrained on an empty queue is undefined.
+     *
+     * @param[out] nextReason  ProcessReason of the next element, `none` if last element
+     *
+     * @return  reference to the newest removed update
+     */
+    std::shared_ptr<T> popDrained(ProcessReason *nextReason = nullptr)
+    {
+        ProcessReason next;
+        std::shared_ptr<T> upd = popUpdate(&next);
+        for (size_t n = 1; n < noOfSlots
+             && upd->getType() == ProcessReason::incomingData
+             && next == ProcessReason::incomingData; n++) {
+            std::shared_ptr<T> newer = popUpdate(&next);
+            newer->override(upd->getOverrides());
+            upd = std::move(newer);
+        }
+        if (nextReason) *nextReason = next;
+        return upd;
+    }
+
+    /**
+     * @brief Checks whether the queue is empty.
+     *
+     * @return  `true` if the queue is empty, `false` otherwise
+     */
+    bool empty() const { return size() == 0; }
+
+    /**
+     * @brief Returns the number of elements.
+     *
+     * @return  number of elements in the queue
+     */
+    size_t size() const
+    {
+        if (conflating)
+            return (latest.load() & dirty) ? 1 : 0;
+        return count.load();
+    }
+
+    /**
+     * @brief Returns the maximum number of elements.
+     *
+     * Returns the maximum allowed number of elements.
+     *
+     * @return  queue capacity (max. number of elements)
+     */
+    size_t capacity() const { return maxElements.load(); }
+
+    /**
+     * @brief Returns the number of updates that were dropped because the queue was full.
+     *
+     * @return  number of dropped updates
+     */
+    unsigned long noOfDropped() const { return dropped.load(); }
+
+    /**
+     * @brief Returns the number of updates that were dropped because they were too old.
+     *
+     * @return  number of expired updates
+     */
+    unsigned long noOfExpired() const { return expired.load(); }
+
+    /**
+     * @brief Returns the max. age of data updates.
+     *
+     * @return  max. age [sec], 0 = no limit
+     */
+    double getMaxAge() const { return maxAge; }
+
+    /**
+     * @brief Returns the high water mark (max. number of elements so far).
+     *
+     * @return  max. number of elements in the queue since creation or last reset
+     */
+    size_t highWaterMark() const { return highWater.load(); }
+
+    /**
+     * @brief Resets the statistics (dropped updates and high water mark).
+     */
+    void resetStats()
+    {
+        dropped.store(0);
+        expired.store(0);
+        highWater.store(size());
+    }
+
+private:
+    static const size_t busy = std::numeric_limits<size_t>::max();
+
+    // Conflating slot: state word of the latest buffer = index | dirty | type of update
+    static const unsigned indexMask = 3u;
+    static const unsigned dirty = 4u;
+    static const unsigned typeShift = 3u;
+
+    // Conflating slot: publish the update, take back the buffer of a dropped one
+    void pushLatest(std::shared_ptr<T> &&update, bool *wasFirst)
+    {
+        Guard G(producerLock); // the back buffer is owned by the producer side
+        const unsigned type = static_cast<unsigned>(update->getType());
+        slots[back].update = std::move(update);
+        unsigned old = latest.exchange(back | dirty | (type << typeShift));
+        back = old & indexMask;
+        std::shared_ptr<T> &drop = slots[back].update;
+        if (old & dirty) {
+            carried.fetch_add(drop->getOverrides() + 1);
+            dropped.fetch_add(1);
+        } else if (!highWater.load()) {
+            highWater.store(1);
+        }
+        drop.reset();
+        if (wasFirst) *wasFirst = !(old & dirty);
+    }
+
+    // Conflating slot: take the latest update (consumer side, slot not empty)
+    std::shared_ptr<T> popLatest(ProcessReason *nextReason)
+    {
+        front = latest.exchange(front) & indexMask;
+        std::shared_ptr<T> upd = std::move(slots[front].update);
+        unsigned long c = carried.exchange(0);
+        if (c)
+            upd->override(c - 1);
+        if (nextReason) {
+            unsigned next = latest.load();
+            *nextReason = (next & dirty) ? static_cast<ProcessReason>(next >> typeShift)
+                                         : ProcessReason::none;
+        }
+        return upd;
+    }
+
+    // Estimated memory of a slot holding an update
+    static const size_t slotBytes = sizeof(Slot) + sizeof(T) + 4 * sizeof(void *);
+
+    // Adaptive sizing (consumer side, after a pop)
+    void adapt()
+    {
+        const size_t cap = noOfSlots;
+        const unsigned long d = dropped.load();
+        if (d != droppedSeen) {
+            droppedSeen = d;
+            if (cap < maxAdaptive && resize(std::min(2 * cap, maxAdaptive)))
+                return;
+        }
+        if (++windowPops < 8 * cap)
+            return;
+        const size_t high = windowHigh.exchange(0);
+        windowPops = 0;
+        if (cap > minAdaptive && 4 * high <= cap)
+            resize(std::max(minAdaptive, std::max(2 * high, cap / 2)));
+    }
+
+    // Resize the ring, keeping the queued updates (consumer side)
+    bool resize(size_t newSize)
+    {
+        Guard G(producerLock);
+        const size_t n = count.load();
+        const size_t oldSize = noOfSlots;
+        newSize = std::max(newSize, n);
+        if (newSize == oldSize)
+            return false;
+        if (newSize > oldSize) {
+            if (!ClientQueueBudget::reserve((newSize - oldSize) * slotBytes))
+                return false;
+        } else {
+            ClientQueueBudget::release((oldSize - newSize) * slotBytes);
+        }
+        std::unique_ptr<Slot[]> ns(new Slot[newSize]);
+        const size_t h = head.load();
+        for (size_t i = 0; i < n; i++) {
+            Slot &o = slot(h + i);
+            ns[i].update = std::move(o.update);
+            ns[i].pushed = o.pushed;
+            ns[i].seq.store(i + 1);
+        }
+        for (size_t i = n; i < newSize; i++)
+            ns[i].seq.store(i);
+        slots = std::move(ns);
+        noOfSlots = newSize;
+        maxElements.store(newSize);
+        head.store(0);
+        tail = n;
+        windowHigh.store(n);
+        windowPops = 0;
+        resizes.fetch_add(1);
+        return true;
+    }
+
+    Slot &slot(const size_t pos) { return slots[pos % noOfSlots]; }
+
+    // Remove the front update (consumer side, queue not empty), applying carried over overrides
+    std::shared_ptr<T> popFront(epicsTime &pushed, size_t &remaining)
+    {
+        size_t h;
+        while (!claimFront(h))
+            std::this_thread::yield();
+        Slot &s = slot(h);
+        std::shared_ptr<T> upd = std::move(s.update);
+        pushed = s.pushed;
+        release(s, h);
+        unsigned long c = carried.exchange(0);
+        if (c)
+            upd->override(c - 1);
+        remaining = count.fetch_sub(1) - 1;
+        return upd;
+    }
+
+    // Claim the front slot (consumer or dropping producer), returns its position
+    bool claimFront(size_t &h)
+    {
+        h = head.load();
+        size_t expected = h + 1;
+        return slot(h).seq.compare_exchange_strong(expected, busy);
+    }
+
+    // Release a claimed front slot (emptied) for the next lap
+    void release(Slot &s, const size_t h)
+    {
+        head.store(h + 1);
+        s.seq.store(h + noOfSlots);
+    }
+
+    // Full queue, discard oldest: drop the front update, push the new one (producerLock held)
+    bool replaceFront(std::shared_ptr<T> &update, const size_t t)
+    {
+        size_t h;
+        if (!claimFront(h))
+            return false; // consumer is popping
+        Slot &s = slot(h);
+        std::shared_ptr<T> drop = std::move(s.update);
+        release(s, h);
+        carried.fetch_add(drop->getOverrides() + 1);
+        dropped.fetch_add(1);
+        // The dropped front slot is the one for the new update
+        Slot &n = slot(t);
+        n.update = std::move(update);
+        if (maxAge > 0.0)
+            n.pushed = epicsTime::getCurrent();
+        n.seq.store(t + 1);
+        tail = t + 1;
+        return true;
+    }
+
+    // Full queue, discard newest: override the back update with the new one (producerLock held)
+    bool replaceBack(T &update, const size_t t)
+    {
+        Slot &s = slot(t - 1);
+        size_t expected = t;
+        if (!s.seq.compare_exchange_strong(expected, busy))
+            return false; // consumer is popping
+        s.update->override(update);
+        if (maxAge > 0.0)
+            s.pushed = epicsTime::getCurrent();
+        s.seq.store(t);
+        dropped.fetch_add(1);
+        return true;
+    }
+
+    // Get the type of the front update (consumer side, queue not empty)
+    ProcessReason peekType()
+    {
+        for (;;) {
+            const size_t h = head.load();
+            Slot &s = slot(h);
+            size_t expected = h + 1;
+            if (s.seq.compare_exchange_strong(expected, busy)) {
+                ProcessReason reason = s.update->getType();
+                s.seq.store(h + 1);
+                return reason;
+            }
+            std::this_thread::yield(); // producer is dropping or overriding
+        }
+    }
+
+    std::atomic<size_t> maxElements;    // max. number of elements
+    const bool conflating;              // size 1: conflating slot (triple buffer)
+    size_t noOfSlots;                   // number of slots (changed by consumer with producerLock held)
+    const bool discardOldest;
+    const double maxAge;                // max. age of data updates when popping [sec]
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> head;           // position of the front update
+    size_t tail;                        // position for the next update (producerLock)
+    std::atomic<size_t> count;          // number of updates in the queue
+    std::atomic<unsigned long> carried; // overrides carried over from dropped front updates
+    std::atomic<unsigned long> dropped; // statistics: updates dropped on a full queue
+    std::atomic<unsigned long> expired; // statistics: updates dropped for their age
+    std::atomic<size_t> highWater;      // statistics: max. number of elements
+    epicsMutex producerLock;
+    std::atomic<unsigned> latest;       // conflating: state of the latest buffer
+    unsigned back;                      // conflating: buffer owned by the producer (producerLock)
+    unsigned front;                     // conflating: buffer owned by the consumer
+    size_t minAdaptive;                 // adaptive: lower bound
+    size_t maxAdaptive;                 // adaptive: upper bound (0 = not adaptive)
+    std::atomic<size_t> windowHigh;     // adaptive: max. number of elements in current window
+    size_t windowPops;                  // adaptive: pops in current window
+    unsigned long droppedSeen;          // adaptive: dropped counter at last check
+    std::atomic<unsigned long> resizes; // statistics: number of resizes
+};
+
+} // namespace DevOpcua
+
+#endif // DEVOPCUA_RINGUPDATEQUEUE_H
@@ -0,0 +1,146 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#ifndef DEVOPCUA_SPAREPOOL_H
+#define DEVOPCUA_SPAREPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace DevOpcua {
+
+/**
+ * @class SparePool
+ * @brief A bounded lock-free pool of spare pointers (e.g. to nodes or memory blocks).
+ *
+ * Bounded multi-producer multi-consumer FIFO (D. Vyukov's bounded MPMC queue):
+ * any thread may return a spare (put) or take one (get), without locks.
+ * Used to recycle objects between threads without going through the heap.
+ *
+ * The pool does not own the pointers: the owner of the pool is responsible
+ * for draining (and freeing) them before the pool is destroyed, and for freeing
+ * spares that put() rejects. Close to full, put() may also reject a spare while
+ * a concurrent get() is still releasing its cell.
+ *
+ * The template parameter P is the pointer type.
+ */
+template<typename P>
+class SparePool
+{
+    struct Cell {
+        std::atomic<size_t> seq;
+        P ptr;
+    };
+
+public:
+    /**
+     * @brief Construct a pool.
+     *
+     * @param capacity  max. number of spares (rounded up to a power of 2, at least 2)
+     */
+    explicit SparePool(const size_t capacity)
+        : mask(2) // the sequence logic needs at least two cells
+        , putPos(0)
+        , getPos(0)
+    {
+        while (mask < capacity)
+            mask <<= 1;
+        cells.reset(new Cell[mask]);
+        for (size_t i = 0; i < mask; i++)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        mask--;
+    }
+
+    SparePool(const SparePool &) = delete;
+    SparePool &operator=(const SparePool &) = delete;
+
+    /**
+     * @brief Returns a spare to the pool (thread safe).
+     *
+     * @param p  spare pointer
+     *
+     * @return  `true` if the spare was added, `false` if the pool is full
+     */
+    bool put(P p)
+    {
+        size_t pos = putPos.load(std::memory_order_relaxed);
+        Cell *c;
+        for (;;) {
+            c = &cells[pos & mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0) {
+                if (putPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false; // full
+            } else {
+                pos = putPos.load(std::memory_order_relaxed);
+            }
+        }
+        c->ptr = p;
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Takes a spare from the pool (thread safe).
+     *
+     * @return  spare pointer, nullptr if the pool is empty
+     */
+    P get()
+    {
+        size_t pos = getPos.load(std::memory_order_relaxed);
+        Cell *c;
+        for (;;) {
+            c = &cells[pos & mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (getPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return nullptr; // empty
+            } else {
+                pos = getPos.load(std::memory_order_relaxed);
+            }
+        }
+        P p = c->ptr;
+        c->seq.store(pos + mask + 1, std::memory_order_release);
+        return p;
+    }
+
+    /**
+     * @brief Returns the number of spares in the pool (approximate).
+     * @return  number of spares
+     */
+    size_t size() const
+    {
+        return putPos.load(std::memory_order_relaxed) - getPos.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Returns the capacity of the pool.
+     * @return  max. number of spares
+     */
+    size_t capacity() const { return mask + 1; }
+
+private:
+    std::unique_ptr<Cell[]> cells;   /**< ring of cells */
+    size_t mask;                     /**< capacity - 1 */
+    std::atomic<size_t> putPos;      /**< enqueue position */
+    std::atomic<size_t> getPos;      /**< dequeue position */
+};
+
+} // namespace DevOpcua
+
+#endif // DEVOPCUA_SPAREPOOL_H
@@ -0,0 +1,153 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#ifndef DEVOPCUA_TOKENBUCKET_H
+#define DEVOPCUA_TOKENBUCKET_H
+
+#include <algorithm>
+
+#include <epicsMutex.h>
+#include <epicsTime.h>
+
+#include "devOpcua.h"
+
+namespace DevOpcua {
+
+/**
+ * @class TokenBucket
+ * @brief A thread safe token bucket for rate limiting.
+ *
+ * Tokens are added at a constant rate, up to the burst size.
+ * Taking tokens never blocks: the bucket may go into debt, and the caller
+ * is told how long to wait before using the tokens it has taken.
+ * This way, requests of any size (also larger than the burst size) are
+ * served in the order of the calls, and the long-term rate is never exceeded.
+ *
+ * A rate of 0 disables the limiter.
+ */
+class TokenBucket
+{
+public:
+    TokenBucket()
+        : fillRate(0.0)
+        , burst(0.0)
+        , tokens(0.0)
+        , last(epicsTime::getCurrent())
+        , takes(0)
+        , throttled(0)
+        , throttledTime(0.0)
+    {}
+
+    /**
+     * @brief Sets the rate (and burst size) of the bucket.
+     *
+     * The bucket starts out full.
+     *
+     * @param rate  tokens per second, 0 = no limit
+     * @param burstSize  max. number of tokens in the bucket, 0 = rate (one second's worth)
+     */
+    void setRate(const double rate, const double burstSize = 0.0)
+    {
+        Guard G(lock);
+        fillRate = rate;
+        burst = burstSize > 0.0 ? burstSize : std::max(rate, 1.0);
+        tokens = burst;
+        last = epicsTime::getCurrent();
+    }
+
+    /**
+     * @brief Get rate parameter.
+     * @return current rate [tokens/s], 0 = no limit
+     */
+    double rate() const
+    {
+        Guard G(lock);
+        return fillRate;
+    }
+
+    /**
+     * @brief Takes tokens from the bucket.
+     *
+     * @param n  number of tokens to take
+     *
+     * @return  time to wait before using the tokens [sec], 0 = no wait
+     */
+    double take(const double n)
+    {
+        Guard G(lock);
+        if (fillRate <= 0.0)
+            return 0.0;
+        epicsTime now = epicsTime::getCurrent();
+        tokens = std::min(burst, tokens + (now - last) * fillRate);
+        last = now;
+        tokens -= n;
+        takes++;
+        if (tokens >= 0.0)
+            return 0.0;
+        double wait = -tokens / fillRate;
+        throttled++;
+        throttledTime += wait;
+        return wait;
+    }
+
+    /**
+     * @brief Get the number of take operations.
+     * @return number of takes
+     */
+    unsigned long noOfTakes() const
+    {
+        Guard G(lock);
+        return takes;
+    }
+
+    /**
+     * @brief Get the number of take operations that had to wait.
+     * @return number of throttled takes
+     */
+    unsigned long noOfThrottled() const
+    {
+        Guard G(lock);
+        return throttled;
+    }
+
+    /**
+     * @brief Get the accumulated wait time of all throttled takes.
+     * @return total wait time [sec]
+     */
+    double throttledSeconds() const
+    {
+        Guard G(lock);
+        return throttledTime;
+    }
+
+    /**
+     * @brief Resets the throttle statistics.
+     */
+    void resetStats()
+    {
+        Guard G(lock);
+        takes = throttled = 0;
+        throttledTime = 0.0;
+    }
+
+private:
+    mutable epicsMutex lock;
+    double fillRate;         // tokens per second (0 = no limit)
+    double burst;            // max. tokens
+    double tokens;           // current tokens (negative = debt)
+    epicsTime last;          // time of last update
+    unsigned long takes;     // statistics: number of takes
+    unsigned long throttled; // statistics: number of takes that had to wait
+    double throttledTime;    // statistics: sum of wait times [sec]
+};
+
+} // namespace DevOpcua
+
+#endif // DEVOPCUA_TOKENBUCKET_H
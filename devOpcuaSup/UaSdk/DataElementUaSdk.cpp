@@ -29,7 +29,7 @@
 
 #include "ItemUaSdk.h"
 #include "DataElementUaSdk.h"
-#include "UpdateQueue.h"
+#include "RingUpdateQueue.h"
 #include "RecordConnector.h"
 
 namespace DevOpcua {
@@ -49,16 +49,27 @@ DataElementUaSdk::DataElementUaSdk (const std::string &name,
     : DataElement(pconnector, name)
     , pitem(item)
     , mapped(false)
-    , incomingQueue(pconnector->plinkinfo->clientQueueSize, pconnector->plinkinfo->discardOldest)
+    , updatePool(pconnector->plinkinfo->clientQueueSize + 2)
+    , incomingQueue(pconnector->plinkinfo->clientQueueSize, pconnector->plinkinfo->discardOldest,
+                    pconnector->plinkinfo->maxAge)
+    , incomingType(OpcUaType_Null)
+    , incomingIsArray(false)
     , isdirty(false)
-{}
+{
+    if (pconnector->plinkinfo->maxClientQueueSize)
+        incomingQueue.setAdaptive(pconnector->plinkinfo->minClientQueueSize,
+                                  pconnector->plinkinfo->maxClientQueueSize);
+}
 
 DataElementUaSdk::DataElementUaSdk (const std::string &name,
                                     ItemUaSdk *item)
     : DataElement(name)
     , pitem(item)
     , mapped(false)
+    , updatePool(1)
     , incomingQueue(0ul)
+    , incomingType(OpcUaType_Null)
+    , incomingIsArray(false)
     , isdirty(false)
 {}
 
@@ -85,10 +96,19 @@ DataElementUaSdk::show (const int level, const unsigned int indent) const
     if (isLeaf()) {
         std::cout << "leaf=" << name << " record(" << pconnector->getRecordType() << ")="
                   << pconnector->getRecordName()
-                  << " type=" << variantTypeString(incomingData.type())
+                  << " type=" << variantTypeString(incomingType)
                   << " timestamp=" << (pconnector->plinkinfo->useServerTimestamp ? "server" : "source")
                   << " bini=" << linkOptionBiniString(pconnector->plinkinfo->bini)
-                  << " monitor=" << (pconnector->plinkinfo->monitor ? "y" : "n") << "\n";
+                  << " monitor=" << (pconnector->plinkinfo->monitor ? "y" : "n")
+                  << " queue=" << incomingQueue.size() << "/" << incomingQueue.capacity()
+                  << " hwm=" << incomingQueue.highWaterMark()
+                  << " dropped=" << incomingQueue.noOfDropped();
+        if (pconnector->plinkinfo->maxClientQueueSize)
+            std::cout << " resized=" << incomingQueue.noOfResizes();
+        if (incomingQueue.getMaxAge() > 0.0)
+            std::cout << " maxage=" << incomingQueue.getMaxAge()
+                      << " expired=" << incomingQueue.noOfExpired();
+        std::cout << "\n";
     } else {
         std::cout << "node=" << name << " children=" << elements.size()
                   << " mapped=" << (mapped ? "y" : "n") << "\n";
@@ -103,19 +123,26 @@ DataElementUaSdk::show (const int level, const unsigned int indent) const
 // Getting the timestamp and status information from the Item assumes that only one thread
 // is pushing data into the Item's DataElement structure at any time.
 void
-DataElementUaSdk::setIncomingData (const UaVariant &value, ProcessReason reason)
+DataElementUaSdk::setIncomingData (const OpcUa_Variant &value, ProcessReason reason)
 {
-    // Make a copy of this element and cache it
-    incomingData = value;
+    // Cache the type, and (for structures) a copy of the value
+    incomingType = static_cast<OpcUa_BuiltInType>(value.Datatype);
+    incomingIsArray = (value.ArrayType == OpcUa_VariantArrayType_Array);
+    if (!isLeaf())
+        incomingData = UaVariant(value);
 
     if (isLeaf()) {
         if ((pitem->state() == ConnectionStatus::initialRead && reason == ProcessReason::readComplete) ||
                 (pitem->state() == ConnectionStatus::up)) {
             Guard(pconnector->lock);
             bool wasFirst = false;
-            // Make a copy of the value for this element and put it on the queue
-            UpdateUaSdk *u(new UpdateUaSdk(getIncomingTimeStamp(), reason, value, getIncomingReadStatus()));
-            incomingQueue.pushUpdate(std::shared_ptr<UpdateUaSdk>(u), &wasFirst);
+            // Make a copy of the value for this element (directly inside the update)
+            // and put it on the queue
+            // (update and shared_ptr control block in one block from the element's pool)
+            incomingQueue.pushUpdate(std::allocate_shared<UpdateUaSdk>(PoolAllocator<UpdateUaSdk>(updatePool),
+                                                                       getIncomingTimeStamp(), reason,
+                                                                       value, getIncomingReadStatus()),
+                                     &wasFirst);
             if (debug() >= 5)
                 std::cout << "Element " << name << " set data ("
                           << processReasonString(reason)
@@ -130,13 +157,14 @@ DataElementUaSdk::setIncomingData (const UaVariant &value, ProcessReason reason)
             std::cout << "Element " << name << " splitting structured data to "
                       << elements.size() << " child elements" << std::endl;
 
-        if (value.type() == OpcUaType_ExtensionObject) {
+        if (incomingData.type() == OpcUaType_ExtensionObject) {
             UaExtensionObject extensionObject;
-            value.toExtensionObject(extensionObject);
+            incomingData.toExtensionObject(extensionObject);
 
-            // Try to get the structure definition from the dictionary
-            UaStructureDefinition definition = pitem->structureDefinition(extensionObject.encodingTypeId());
-            if (!definition.isNull()) {
+            // Try to get the structure definition (cached in the session)
+            std::shared_ptr<const StructureInfo> info = pitem->structureInfo(extensionObject.encodingTypeId());
+            if (info) {
+                const UaStructureDefinition &definition = info->definition;
                 if (!definition.isUnion()) {
                     // ExtensionObject is a structure
                     // Decode the ExtensionObject to a UaGenericValue to provide access to the structure fields
@@ -148,11 +176,10 @@ DataElementUaSdk::setIncomingData (const UaVariant &value, ProcessReason reason)
                             std::cout << " ** creating index-to-element map for child elements" << std::endl;
                         for (auto &it : elements) {
                             auto pelem = it.lock();
-                            for (int i = 0; i < definition.childrenCount(); i++) {
-                                if (pelem->name == definition.child(i).name().toUtf8()) {
-                                    elementMap.insert({i, it});
-                                    pelem->setIncomingData(genericValue.value(i), reason);
-                                }
+                            auto child = info->childIndex.find(pelem->name);
+                            if (child != info->childIndex.end()) {
+                                elementMap.insert({child->second, it});
+                                pelem->setIncomingData(genericValue.value(child->second), reason);
                             }
                         }
                         if (debug() >= 5)
@@ -182,8 +209,9 @@ DataElementUaSdk::setIncomingEvent (ProcessReason reason)
         Guard(pconnector->lock);
         bool wasFirst = false;
         // Put the event on the queue
-        UpdateUaSdk *u(new UpdateUaSdk(getIncomingTimeStamp(), reason));
-        incomingQueue.pushUpdate(std::shared_ptr<UpdateUaSdk>(u), &wasFirst);
+        incomingQueue.pushUpdate(std::allocate_shared<UpdateUaSdk>(PoolAllocator<UpdateUaSdk>(updatePool),
+                                                                   getIncomingTimeStamp(), reason),
+                                 &wasFirst);
         if (debug() >= 5)
             std::cout << "Element " << name << " set event ("
                       << processReasonString(reason)
@@ -241,9 +269,10 @@ DataElementUaSdk::getOutgoingData ()
             UaExtensionObject extensionObject;
             outgoingData.toExtensionObject(extensionObject);
 
-            // Try to get the structure definition from the dictionary
-            UaStructureDefinition definition = pitem->structureDefinition(extensionObject.encodingTypeId());
-            if (!definition.isNull()) {
+            // Try to get the structure definition (cached in the session)
+            std::shared_ptr<const StructureInfo> info = pitem->structureInfo(extensionObject.encodingTypeId());
+            if (info) {
+                const UaStructureDefinition &definition = info->definition;
                 if (!definition.isUnion()) {
                     // ExtensionObject is a structure
                     // Decode the ExtensionObject to a UaGenericValue to provide access to the structure fields
@@ -255,12 +284,11 @@ DataElementUaSdk::getOutgoingData ()
                             std::cout << " ** creating index-to-element map for child elements" << std::endl;
                         for (auto &it : elements) {
                             auto pelem = it.lock();
-                            for (int i = 0; i < definition.childrenCount(); i++) {
-                                if (pelem->name == definition.child(i).name().toUtf8()) {
-                                    elementMap.insert({i, it});
-                                    if (updateDataInGenericValue(genericValue, i, pelem))
-                                        isdirty = true;
-                                }
+                            auto child = info->childIndex.find(pelem->name);
+                            if (child != info->childIndex.end()) {
+                                elementMap.insert({child->second, it});
+                                if (updateDataInGenericValue(genericValue, child->second, pelem))
+                                    isdirty = true;
                             }
                         }
                         if (debug() >= 5)
@@ -389,7 +417,7 @@ DataElementUaSdk::readScalar (char *value, const size_t num,
     }
 
     ProcessReason nReason;
-    std::shared_ptr<UpdateUaSdk> upd = incomingQueue.popUpdate(&nReason);
+    std::shared_ptr<UpdateUaSdk> upd = popIncoming(&nReason);
     dbgReadScalar(upd.get(), "CString", num);
 
     switch (upd->getType()) {
@@ -485,7 +513,7 @@ DataElementUaSdk::readArray (char **value, const epicsUInt32 len,
     }
 
     ProcessReason nReason;
-    std::shared_ptr<UpdateUaSdk> upd = incomingQueue.popUpdate(&nReason);
+    std::shared_ptr<UpdateUaSdk> upd = popIncoming(&nReason);
     dbgReadArray(upd.get(), num, epicsTypeString(**value));
 
     switch (upd->getType()) {
@@ -551,94 +579,6 @@ DataElementUaSdk::readArray (char **value, const epicsUInt32 len,
     return ret;
 }
 
-// Specialization for epicsUInt8 / OpcUa_Byte
-//   (needed because UaByteArray API is different from all other UaXxxArray classes)
-// CAVEAT: changes in the template (in DataElementUaSdk.h) must be reflected here
-template<>
-long
-DataElementUaSdk::readArray<epicsUInt8, UaByteArray> (epicsUInt8 *value, const epicsUInt32 num,
-                                                      epicsUInt32 *numRead,
-                                                      OpcUa_BuiltInType expectedType,
-                                                      dbCommon *prec,
-                                                      ProcessReason *nextReason,
-                                                      epicsUInt32 *statusCode,
-                                                      char *statusText,
-                                                      const epicsUInt32 statusTextLen)
-{
-    long ret = 0;
-    epicsUInt32 elemsWritten = 0;
-
-    if (incomingQueue.empty()) {
-        errlogPrintf("%s : incoming data queue empty\n", prec->name);
-        *numRead = 0;
-        return 1;
-    }
-
-    ProcessReason nReason;
-    std::shared_ptr<UpdateUaSdk> upd = incomingQueue.popUpdate(&nReason);
-    dbgReadArray(upd.get(), num, epicsTypeString(*value));
-
-    switch (upd->getType()) {
-    case ProcessReason::readFailure:
-        (void) recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
-        ret = 1;
-        break;
-    case ProcessReason::connectionLoss:
-        (void) recGblSetSevr(prec, COMM_ALARM, INVALID_ALARM);
-        ret = 1;
-        break;
-    case ProcessReason::incomingData:
-    case ProcessReason::readComplete:
-    {
-        if (num && value) {
-            OpcUa_StatusCode stat = upd->getStatus();
-            if (OpcUa_IsNotGood(stat)) {
-                // No valid OPC UA value
-                (void) recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
-                ret = 1;
-            } else {
-                // Valid OPC UA value, so try to convert
-                UaVariant &data = upd->getData();
-                if (!data.isArray()) {
-                    errlogPrintf("%s : incoming data is not an array\n", prec->name);
-                    (void) recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
-                    ret = 1;
-                } else if (data.type() != expectedType) {
-                    errlogPrintf("%s : incoming data type (%s) does not match EPICS array type (%s)\n",
-                                 prec->name, variantTypeString(data.type()), epicsTypeString(*value));
-                    (void) recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
-                    ret = 1;
-                } else {
-                    if (OpcUa_IsUncertain(stat)) {
-                        (void) recGblSetSevr(prec, READ_ALARM, MINOR_ALARM);
-                    }
-                    UaByteArray arr;
-                    UaVariant_to(upd->getData(), arr);
-                    elemsWritten = static_cast<epicsUInt32>(arr.size());
-                    if (num < elemsWritten) elemsWritten = num;
-                    memcpy(value, arr.data(), sizeof(epicsUInt8) * elemsWritten);
-                    prec->udf = false;
-                }
-            }
-            if (statusCode) *statusCode = stat;
-            if (statusText) {
-                strncpy(statusText, UaStatus(stat).toString().toUtf8(), statusTextLen);
-                statusText[statusTextLen-1] = '\0';
-            }
-        }
-        break;
-    }
-    default:
-        break;
-    }
-
-    prec->time = upd->getTimeStamp();
-    if (nextReason) *nextReason = nReason;
-    if (num)
-        *numRead = elemsWritten;
-    return ret;
-}
-
 long
 DataElementUaSdk::readArray (epicsInt8 *value, const epicsUInt32 num,
                              epicsUInt32 *numRead,
@@ -648,7 +588,7 @@ DataElementUaSdk::readArray (epicsInt8 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsInt8, UaSByteArray>(value, num, numRead, OpcUaType_SByte, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsInt8>(value, num, numRead, OpcUaType_SByte, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -660,7 +600,7 @@ DataElementUaSdk::readArray (epicsUInt8 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsUInt8, UaByteArray>(value, num, numRead, OpcUaType_Byte, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsUInt8>(value, num, numRead, OpcUaType_Byte, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -672,7 +612,7 @@ DataElementUaSdk::readArray (epicsInt16 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsInt16, UaInt16Array>(value, num, numRead, OpcUaType_Int16, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsInt16>(value, num, numRead, OpcUaType_Int16, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -684,7 +624,7 @@ DataElementUaSdk::readArray (epicsUInt16 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsUInt16, UaUInt16Array>(value, num, numRead, OpcUaType_UInt16, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsUInt16>(value, num, numRead, OpcUaType_UInt16, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -696,7 +636,7 @@ DataElementUaSdk::readArray (epicsInt32 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsInt32, UaInt32Array>(value, num, numRead, OpcUaType_Int32, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsInt32>(value, num, numRead, OpcUaType_Int32, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -708,7 +648,7 @@ DataElementUaSdk::readArray (epicsUInt32 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsUInt32, UaUInt32Array>(value, num, numRead, OpcUaType_UInt32, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsUInt32>(value, num, numRead, OpcUaType_UInt32, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -720,7 +660,7 @@ DataElementUaSdk::readArray (epicsInt64 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsInt64, UaInt64Array>(value, num, numRead, OpcUaType_Int64, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsInt64>(value, num, numRead, OpcUaType_Int64, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -732,7 +672,7 @@ DataElementUaSdk::readArray (epicsUInt64 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsUInt64, UaUInt64Array>(value, num, numRead, OpcUaType_UInt64, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsUInt64>(value, num, numRead, OpcUaType_UInt64, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -744,7 +684,7 @@ DataElementUaSdk::readArray (epicsFloat32 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsFloat32, UaFloatArray>(value, num, numRead, OpcUaType_Float, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsFloat32>(value, num, numRead, OpcUaType_Float, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -756,7 +696,7 @@ DataElementUaSdk::readArray (epicsFloat64 *value, const epicsUInt32 num,
                              char *statusText,
                              const epicsUInt32 statusTextLen)
 {
-    return readArray<epicsFloat64, UaDoubleArray>(value, num, numRead, OpcUaType_Double, prec, nextReason, statusCode, statusText, statusTextLen);
+    return readArray<epicsFloat64>(value, num, numRead, OpcUaType_Double, prec, nextReason, statusCode, statusText, statusTextLen);
 }
 
 long
@@ -819,7 +759,7 @@ DataElementUaSdk::writeScalar (const char *value, const epicsUInt32 len, dbCommo
     unsigned long ul;
     double d;
 
-    switch (incomingData.type()) {
+    switch (incomingType) {
     case OpcUaType_String:
     { // Scope of Guard G
         Guard G(outgoingLock);
@@ -975,14 +915,14 @@ DataElementUaSdk::writeArray (const char **value, const epicsUInt32 len,
 {
     long ret = 0;
 
-    if (!incomingData.isArray()) {
+    if (!incomingIsArray) {
         errlogPrintf("%s : OPC UA data type is not an array\n", prec->name);
         (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
         ret = 1;
-    } else if (incomingData.type() != targetType) {
+    } else if (incomingType != targetType) {
         errlogPrintf("%s : OPC UA data type (%s) does not match expected type (%s) for EPICS array (%s)\n",
                      prec->name,
-                     variantTypeString(incomingData.type()),
+                     variantTypeString(incomingType),
                      variantTypeString(targetType),
                      epicsTypeString(**value));
         (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
@@ -1027,18 +967,12 @@ DataElementUaSdk::writeArray<epicsUInt8, UaByteArray, OpcUa_Byte> (const epicsUI
 {
     long ret = 0;
 
-    if (!incomingData.isArray()) {
+    if (!incomingIsArray) {
         errlogPrintf("%s : OPC UA data type is not an array\n", prec->name);
         (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
         ret = 1;
-    } else if (incomingData.type() != targetType) {
-        errlogPrintf("%s : OPC UA data type (%s) does not match expected type (%s) for EPICS array (%s)\n",
-                     prec->name,
-                     variantTypeString(incomingData.type()),
-                     variantTypeString(targetType),
-                     epicsTypeString(*value));
-        (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-        ret = 1;
+    } else if (incomingType != targetType) {
+        ret = writeConvertedArray(value, num, prec);
     } else {
         UaByteArray arr(reinterpret_cast<const char *>(value), static_cast<OpcUa_Int32>(num));
         { // Scope of Guard G
@@ -15,18 +15,23 @@
 #define DEVOPCUA_DATAELEMENTUASDK_H
 
 #include <unordered_map>
+#include <algorithm>
 #include <limits>
+#include <new>
 
 #include <uadatavalue.h>
 #include <statuscode.h>
 
 #include <errlog.h>
+#include <epicsVersion.h>
 
 #include "DataElement.h"
 #include "devOpcua.h"
 #include "RecordConnector.h"
 #include "Update.h"
-#include "UpdateQueue.h"
+#include "ArrayConversion.h"
+#include "RingUpdateQueue.h"
+#include "UpdatePool.h"
 #include "ItemUaSdk.h"
 
 namespace DevOpcua {
@@ -81,6 +86,204 @@ variantTypeString (const OpcUa_BuiltInType type)
     return "Illegal Value";
 }
 
+// Size of the binary encoding of a scalar value (approximate for complex types)
+inline size_t
+scalarEncodedSize (const OpcUa_BuiltInType type)
+{
+    switch(type) {
+        case OpcUaType_Boolean:
+        case OpcUaType_SByte:
+        case OpcUaType_Byte:            return 1;
+        case OpcUaType_Int16:
+        case OpcUaType_UInt16:          return 2;
+        case OpcUaType_Int32:
+        case OpcUaType_UInt32:
+        case OpcUaType_Float:
+        case OpcUaType_StatusCode:      return 4;
+        case OpcUaType_Int64:
+        case OpcUaType_UInt64:
+        case OpcUaType_Double:
+        case OpcUaType_DateTime:        return 8;
+        case OpcUaType_Guid:            return 16;
+        default:                        return 32;
+    }
+}
+
+// Estimated size of the binary encoding of a variant (used for byte-budgeted batching)
+inline size_t
+variantEncodedSize (const OpcUa_Variant &value)
+{
+    const OpcUa_BuiltInType type = static_cast<OpcUa_BuiltInType>(value.Datatype);
+    size_t size = 1; // encoding mask
+
+    if (value.ArrayType == OpcUa_VariantArrayType_Scalar) {
+        switch (type) {
+        case OpcUaType_Null:
+            break;
+        case OpcUaType_String:
+            size += 4 + OpcUa_String_StrSize(&value.Value.String);
+            break;
+        case OpcUaType_ByteString:
+        case OpcUaType_XmlElement:
+            size += 4 + std::max<OpcUa_Int32>(0, value.Value.ByteString.Length);
+            break;
+        case OpcUaType_ExtensionObject:
+            size += 4 + (value.Value.ExtensionObject
+                         ? std::max<OpcUa_Int32>(0, value.Value.ExtensionObject->BodySize) : 0);
+            break;
+        default:
+            size += scalarEncodedSize(type);
+        }
+    } else if (value.ArrayType == OpcUa_VariantArrayType_Array) {
+        const OpcUa_Int32 n = std::max<OpcUa_Int32>(0, value.Value.Array.Length);
+        size += 4;
+        switch (type) {
+        case OpcUaType_String:
+            for (OpcUa_Int32 i = 0; i < n; i++)
+                size += 4 + OpcUa_String_StrSize(&value.Value.Array.Value.StringArray[i]);
+            break;
+        case OpcUaType_ByteString:
+        case OpcUaType_XmlElement:
+            for (OpcUa_Int32 i = 0; i < n; i++)
+                size += 4 + std::max<OpcUa_Int32>(0, value.Value.Array.Value.ByteStringArray[i].Length);
+            break;
+        case OpcUaType_ExtensionObject:
+            for (OpcUa_Int32 i = 0; i < n; i++)
+                size += 4 + std::max<OpcUa_Int32>(0, value.Value.Array.Value.ExtensionObjectArray[i].BodySize);
+            break;
+        default:
+            size += n * scalarEncodedSize(type);
+        }
+    } else {
+        // Matrix: product of the dimensions
+        size_t n = 1;
+        for (OpcUa_Int32 i = 0; i < value.Value.Matrix.NoOfDimensions; i++)
+            n *= std::max<OpcUa_Int32>(0, value.Value.Matrix.Dimensions[i]);
+        size += 4 + 4 * value.Value.Matrix.NoOfDimensions + n * scalarEncodedSize(type);
+    }
+    return size;
+}
+
+// Template for lossless conversion of a built-in scalar (compile time check)
+template<typename TO, typename FROM>
+inline bool losslessTo (const FROM &from, TO &to) {
+    typedef std::numeric_limits<FROM> F;
+    typedef std::numeric_limits<TO> T;
+    if (T::digits >= F::digits
+            && (T::is_signed || !F::is_signed)
+            && (F::is_integer || !T::is_integer)) {
+        to = static_cast<TO>(from);
+        return true;
+    }
+    return false;
+}
+
+// Direct conversion of a built-in scalar from the variant's value union,
+// without going through the SDK's conversion.
+// Only lossless conversions are done, everything else (narrowing, conversion
+// from strings etc.) is left to the UaVariant::toXxx() methods.
+template<typename TO>
+inline bool
+scalarFromVariant (const OpcUa_Variant &variant, TO &value)
+{
+    if (variant.ArrayType != OpcUa_VariantArrayType_Scalar)
+        return false;
+    switch (variant.Datatype) {
+    case OpcUaType_Boolean: value = variant.Value.Boolean ? 1 : 0; return true;
+    case OpcUaType_SByte:   return losslessTo(variant.Value.SByte, value);
+    case OpcUaType_Byte:    return losslessTo(variant.Value.Byte, value);
+    case OpcUaType_Int16:   return losslessTo(variant.Value.Int16, value);
+    case OpcUaType_UInt16:  return losslessTo(variant.Value.UInt16, value);
+    case OpcUaType_Int32:   return losslessTo(variant.Value.Int32, value);
+    case OpcUaType_UInt32:  return losslessTo(variant.Value.UInt32, value);
+    case OpcUaType_Int64:   return losslessTo(variant.Value.Int64, value);
+    case OpcUaType_UInt64:  return losslessTo(variant.Value.UInt64, value);
+    case OpcUaType_Float:   return losslessTo(variant.Value.Float, value);
+    case OpcUaType_Double:  return losslessTo(variant.Value.Double, value);
+    default:                return false;
+    }
+}
+
+// Element-wise conversion of a numeric array from the variant's value union
+// into an EPICS array, saturating out of range elements (see ArrayConversion.h).
+// Returns false if the variant does not hold a one-dimensional numeric array.
+template<typename ET>
+inline bool
+arrayFromVariant (const OpcUa_Variant &variant, ET *value, const epicsUInt32 num,
+                  epicsUInt32 &elemsWritten, bool &clipped)
+{
+    if (variant.ArrayType != OpcUa_VariantArrayType_Array)
+        return false;
+    const OpcUa_VariantArrayUnion &a = variant.Value.Array.Value;
+    const size_t n = std::min<size_t>(num, std::max<OpcUa_Int32>(0, variant.Value.Array.Length));
+    switch (variant.Datatype) {
+    case OpcUaType_Boolean: clipped = convertArray(value, a.BooleanArray, n); break;
+    case OpcUaType_SByte:   clipped = convertArray(value, a.SByteArray, n); break;
+    case OpcUaType_Byte:    clipped = convertArray(value, a.ByteArray, n); break;
+    case OpcUaType_Int16:   clipped = convertArray(value, a.Int16Array, n); break;
+    case OpcUaType_UInt16:  clipped = convertArray(value, a.UInt16Array, n); break;
+    case OpcUaType_Int32:   clipped = convertArray(value, a.Int32Array, n); break;
+    case OpcUaType_UInt32:  clipped = convertArray(value, a.UInt32Array, n); break;
+    case OpcUaType_Int64:   clipped = convertArray(value, a.Int64Array, n); break;
+    case OpcUaType_UInt64:  clipped = convertArray(value, a.UInt64Array, n); break;
+    case OpcUaType_Float:   clipped = convertArray(value, a.FloatArray, n); break;
+    case OpcUaType_Double:  clipped = convertArray(value, a.DoubleArray, n); break;
+    default:                return false;
+    }
+    elemsWritten = static_cast<epicsUInt32>(n);
+    return true;
+}
+
+// Range checked element-wise conversion of an EPICS array into a newly allocated
+// numeric array of the given type in an (empty) OpcUa_Variant.
+// Returns the index of the first element out of range (the variant is not set),
+// num if all elements are in range.
+template<typename ST, typename ET>
+inline epicsUInt32
+convertToVariantArray (OpcUa_Variant &variant, const OpcUa_BuiltInType type,
+                       const ET *value, const epicsUInt32 num)
+{
+    ST *arr = static_cast<ST *>(OpcUa_Alloc(static_cast<OpcUa_UInt32>(sizeof(ST) * std::max<epicsUInt32>(num, 1))));
+    if (!arr)
+        throw std::bad_alloc();
+    const size_t bad = convertArrayChecked(arr, value, num);
+    if (bad < num) {
+        OpcUa_Free(arr);
+        return static_cast<epicsUInt32>(bad);
+    }
+    OpcUa_Variant_Initialize(&variant);
+    variant.Datatype = static_cast<OpcUa_Byte>(type);
+    variant.ArrayType = OpcUa_VariantArrayType_Array;
+    variant.Value.Array.Length = static_cast<OpcUa_Int32>(num);
+    variant.Value.Array.Value.Array = arr;
+    return num;
+}
+
+// Range checked element-wise conversion of an EPICS array into a numeric
+// OpcUa_Variant array of the given type (see ArrayConversion.h).
+// Returns false if the type is not numeric; firstOutOfRange is set to the index
+// of the first element out of range, num if all elements are in range.
+template<typename ET>
+inline bool
+arrayToVariant (OpcUa_Variant &variant, const OpcUa_BuiltInType type,
+                const ET *value, const epicsUInt32 num, epicsUInt32 &firstOutOfRange)
+{
+    switch (type) {
+    case OpcUaType_SByte:  firstOutOfRange = convertToVariantArray<OpcUa_SByte>(variant, type, value, num); break;
+    case OpcUaType_Byte:   firstOutOfRange = convertToVariantArray<OpcUa_Byte>(variant, type, value, num); break;
+    case OpcUaType_Int16:  firstOutOfRange = convertToVariantArray<OpcUa_Int16>(variant, type, value, num); break;
+    case OpcUaType_UInt16: firstOutOfRange = convertToVariantArray<OpcUa_UInt16>(variant, type, value, num); break;
+    case OpcUaType_Int32:  firstOutOfRange = convertToVariantArray<OpcUa_Int32>(variant, type, value, num); break;
+    case OpcUaType_UInt32: firstOutOfRange = convertToVariantArray<OpcUa_UInt32>(variant, type, value, num); break;
+    case OpcUaType_Int64:  firstOutOfRange = convertToVariantArray<OpcUa_Int64>(variant, type, value, num); break;
+    case OpcUaType_UInt64: firstOutOfRange = convertToVariantArray<OpcUa_UInt64>(variant, type, value, num); break;
+    case OpcUaType_Float:  firstOutOfRange = convertToVariantArray<OpcUa_Float>(variant, type, value, num); break;
+    case OpcUaType_Double: firstOutOfRange = convertToVariantArray<OpcUa_Double>(variant, type, value, num); break;
+    default:               return false;
+    }
+    return true;
+}
+
 // Template for range check when writing
 template<typename TO, typename FROM>
 inline bool isWithinRange (const FROM &value) {
@@ -150,6 +353,146 @@ template<> inline bool isWithinRange<OpcUa_Double, epicsInt64> (const epicsInt64
 
 template<> inline bool isWithinRange<OpcUa_Double, epicsFloat64> (const epicsFloat64 &) { return true; }
 
+// Overloaded helper functions that wrap the UaVariant::setXxx() methods for built-in scalars
+inline void setScalar (UaVariant &variant, const OpcUa_SByte value) { variant.setSByte(value); }
+inline void setScalar (UaVariant &variant, const OpcUa_Byte value) { variant.setByte(value); }
+inline void setScalar (UaVariant &variant, const OpcUa_Int16 value) { variant.setInt16(value); }
+inline void setScalar (UaVariant &variant, const OpcUa_UInt16 value) { variant.setUInt16(value); }
+inline void setScalar (UaVariant &variant, const OpcUa_Int32 value) { variant.setInt32(value); }
+inline void setScalar (UaVariant &variant, const OpcUa_UInt32 value) { variant.setUInt32(value); }
+inline void setScalar (UaVariant &variant, const OpcUa_Int64 value) { variant.setInt64(value); }
+inline void setScalar (UaVariant &variant, const OpcUa_UInt64 value) { variant.setUInt64(value); }
+inline void setScalar (UaVariant &variant, const OpcUa_Float value) { variant.setFloat(value); }
+inline void setScalar (UaVariant &variant, const OpcUa_Double value) { variant.setDouble(value); }
+
+/**
+ * @brief Direct readers of built-in scalars from the variant's value union into an OPC UA type.
+ *
+ * resolve() does the type switch once, the returned function does the conversion
+ * (lossless conversions only, see scalarFromVariant).
+ */
+template<typename TO>
+struct ScalarReader
+{
+    typedef bool (*Reader)(const OpcUa_Variant &variant, TO &value);
+
+    static bool fromBoolean (const OpcUa_Variant &v, TO &value) { value = v.Value.Boolean ? 1 : 0; return true; }
+    static bool fromSByte (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.SByte, value); }
+    static bool fromByte (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.Byte, value); }
+    static bool fromInt16 (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.Int16, value); }
+    static bool fromUInt16 (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.UInt16, value); }
+    static bool fromInt32 (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.Int32, value); }
+    static bool fromUInt32 (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.UInt32, value); }
+    static bool fromInt64 (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.Int64, value); }
+    static bool fromUInt64 (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.UInt64, value); }
+    static bool fromFloat (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.Float, value); }
+    static bool fromDouble (const OpcUa_Variant &v, TO &value) { return losslessTo(v.Value.Double, value); }
+
+    // Returns the reader for a built-in type, nullptr if there is no lossless direct conversion
+    static Reader resolve (const OpcUa_BuiltInType type)
+    {
+        TO probe;
+        switch (type) {
+        case OpcUaType_Boolean: return &fromBoolean;
+        case OpcUaType_SByte:   return losslessTo(OpcUa_SByte(), probe) ? &fromSByte : nullptr;
+        case OpcUaType_Byte:    return losslessTo(OpcUa_Byte(), probe) ? &fromByte : nullptr;
+        case OpcUaType_Int16:   return losslessTo(OpcUa_Int16(), probe) ? &fromInt16 : nullptr;
+        case OpcUaType_UInt16:  return losslessTo(OpcUa_UInt16(), probe) ? &fromUInt16 : nullptr;
+        case OpcUaType_Int32:   return losslessTo(OpcUa_Int32(), probe) ? &fromInt32 : nullptr;
+        case OpcUaType_UInt32:  return losslessTo(OpcUa_UInt32(), probe) ? &fromUInt32 : nullptr;
+        case OpcUaType_Int64:   return losslessTo(OpcUa_Int64(), probe) ? &fromInt64 : nullptr;
+        case OpcUaType_UInt64:  return losslessTo(OpcUa_UInt64(), probe) ? &fromUInt64 : nullptr;
+        case OpcUaType_Float:   return losslessTo(OpcUa_Float(), probe) ? &fromFloat : nullptr;
+        case OpcUaType_Double:  return losslessTo(OpcUa_Double(), probe) ? &fromDouble : nullptr;
+        default:                return nullptr;
+        }
+    }
+};
+
+/**
+ * @brief Range checked writers of an EPICS scalar into a UaVariant of a built-in type.
+ *
+ * resolve() does the type switch once, the returned function does the conversion.
+ * A writer returns false (leaving the variant untouched) if the value is out of range.
+ */
+template<typename ET>
+struct ScalarWriter
+{
+    typedef bool (*Writer)(UaVariant &variant, const ET &value);
+
+    template<typename ST>
+    static bool as (UaVariant &variant, const ET &value)
+    {
+        if (!isWithinRange<ST>(value))
+            return false;
+        setScalar(variant, static_cast<ST>(value));
+        return true;
+    }
+    static bool asBoolean (UaVariant &variant, const ET &value)
+    {
+        variant.setBoolean(value != 0);
+        return true;
+    }
+    static bool asString (UaVariant &variant, const ET &value)
+    {
+        variant.setString(static_cast<UaString>(std::to_string(value).c_str()));
+        return true;
+    }
+
+    // Returns the writer for a built-in type, nullptr if the conversion is not supported
+    static Writer resolve (const OpcUa_BuiltInType type)
+    {
+        switch (type) {
+        case OpcUaType_Boolean: return &asBoolean;
+        case OpcUaType_SByte:   return &as<OpcUa_SByte>;
+        case OpcUaType_Byte:    return &as<OpcUa_Byte>;
+        case OpcUaType_Int16:   return &as<OpcUa_Int16>;
+        case OpcUaType_UInt16:  return &as<OpcUa_UInt16>;
+        case OpcUaType_Int32:   return &as<OpcUa_Int32>;
+        case OpcUaType_UInt32:  return &as<OpcUa_UInt32>;
+        case OpcUaType_Int64:   return &as<OpcUa_Int64>;
+        case OpcUaType_UInt64:  return &as<OpcUa_UInt64>;
+        case OpcUaType_Float:   return &as<OpcUa_Float>;
+        case OpcUaType_Double:  return &as<OpcUa_Double>;
+        case OpcUaType_String:  return &asString;
+        default:                return nullptr;
+        }
+    }
+};
+
+/**
+ * @brief Converter function cached for the OPC UA type it was resolved for.
+ *
+ * get() only resolves (through the type switch) when the type differs from the
+ * cached one, i.e. at first data and when the server side type changes.
+ */
+template<typename F>
+struct CachedConverter
+{
+    CachedConverter() : type(OpcUa_Null), fn(nullptr) {}
+
+    template<typename R>
+    F get (const OpcUa_BuiltInType t, R resolve)
+    {
+        if (t != type) {
+            fn = resolve(t);
+            type = t;
+        }
+        return fn;
+    }
+
+    OpcUa_BuiltInType type;   /**< OPC UA type the converter was resolved for */
+    F fn;                     /**< converter (nullptr = no direct conversion) */
+};
+
+// Cached scalar converters for one EPICS type (and its OPC UA read type)
+template<typename ET, typename OT>
+struct ScalarConverters
+{
+    CachedConverter<typename ScalarReader<OT>::Reader> reader;
+    CachedConverter<typename ScalarWriter<ET>::Writer> writer;
+};
+
 /**
  * @brief The DataElementUaSdk implementation of a single piece of data.
  *
@@ -234,7 +577,18 @@ public:
      * @param value  new value for this data element
      * @param reason  reason for this value update
      */
-    void setIncomingData(const UaVariant &value, ProcessReason reason);
+    void setIncomingData(const OpcUa_Variant &value, ProcessReason reason);
+
+    /**
+     * @brief Push an incoming data value into the DataElement.
+     *
+     * @param value  new value for this data element
+     * @param reason  reason for this value update
+     */
+    void setIncomingData(const UaVariant &value, ProcessReason reason)
+    {
+        setIncomingData(*static_cast<const OpcUa_Variant *>(value), reason);
+    }
 
     /**
      * @brief Push an incoming event into the DataElement.
@@ -689,12 +1043,41 @@ private:
     // Get the read status from the incoming object
     OpcUa_StatusCode getIncomingReadStatus() const { return pitem->getLastStatus().code(); }
 
+    // Get the next update from the incoming queue (draining runs of data updates if configured)
+    std::shared_ptr<UpdateUaSdk> popIncoming(ProcessReason *nextReason) {
+        if (pconnector->plinkinfo->drainQueue)
+            return incomingQueue.popDrained(nextReason);
+        return incomingQueue.popUpdate(nextReason);
+    }
+
     // Overloaded helper functions that wrap the UaVariant::toXxx() and UaVariant::setXxx methods
     OpcUa_StatusCode UaVariant_to(const UaVariant &variant, OpcUa_Int32 &value) { return variant.toInt32(value); }
     OpcUa_StatusCode UaVariant_to(const UaVariant &variant, OpcUa_UInt32 &value) { return variant.toUInt32(value); }
     OpcUa_StatusCode UaVariant_to(const UaVariant &variant, OpcUa_Int64 &value) { return variant.toInt64(value); }
     OpcUa_StatusCode UaVariant_to(const UaVariant &variant, OpcUa_Double &value) { return variant.toDouble(value); }
 
+    // Scalar conversion: built-in types directly from the value union, the SDK conversion otherwise
+    // (the direct reader is resolved once per incoming type and cached)
+    template<typename OT>
+    OpcUa_StatusCode scalar_to(const UaVariant &variant, OT &value,
+                               CachedConverter<typename ScalarReader<OT>::Reader> &cache)
+    {
+        const OpcUa_Variant *v = variant;
+        if (v->ArrayType == OpcUa_VariantArrayType_Scalar) {
+            typename ScalarReader<OT>::Reader read =
+                    cache.get(static_cast<OpcUa_BuiltInType>(v->Datatype), &ScalarReader<OT>::resolve);
+            if (read && read(*v, value))
+                return OpcUa_Good;
+        }
+        return UaVariant_to(variant, value);
+    }
+
+    // Cached scalar converters per EPICS type
+    ScalarConverters<epicsInt32, OpcUa_Int32> &converters(const epicsInt32 *) { return convInt32; }
+    ScalarConverters<epicsUInt32, OpcUa_UInt32> &converters(const epicsUInt32 *) { return convUInt32; }
+    ScalarConverters<epicsInt64, OpcUa_Int64> &converters(const epicsInt64 *) { return convInt64; }
+    ScalarConverters<epicsFloat64, OpcUa_Double> &converters(const epicsFloat64 *) { return convFloat64; }
+
     OpcUa_StatusCode UaVariant_to(const UaVariant &variant, UaSByteArray &value) { return variant.toSByteArray(value); }
     OpcUa_StatusCode UaVariant_to(const UaVariant &variant, UaByteArray &value) { return variant.toByteArray(value); }
     OpcUa_StatusCode UaVariant_to(const UaVariant &variant, UaInt16Array &value) { return variant.toInt16Array(value); }
@@ -739,7 +1122,7 @@ private:
         }
 
         ProcessReason nReason;
-        std::shared_ptr<UpdateUaSdk> upd = incomingQueue.popUpdate(&nReason);
+        std::shared_ptr<UpdateUaSdk> upd = popIncoming(&nReason);
         dbgReadScalar(upd.get(), epicsTypeString(*value));
 
         switch (upd->getType()) {
@@ -763,7 +1146,7 @@ private:
                 } else {
                     // Valid OPC UA value, so try to convert
                     OT v;
-                    if (OpcUa_IsNotGood(UaVariant_to(upd->getData(), v))) {
+                    if (OpcUa_IsNotGood(scalar_to(upd->getData(), v, converters(value).reader))) {
                         errlogPrintf("%s : incoming data (%s) out-of-bounds\n",
                                      prec->name,
                                      upd->getData().toString().toUtf8());
@@ -793,10 +1176,11 @@ private:
         return ret;
     }
 
-    // Read array value as templated function on EPICS type and OPC UA type
-    // (latter *must match* OPC UA type enum argument)
-    // CAVEAT: changes must also be reflected in specializations (in DataElementUaSdk.cpp)
-    template<typename ET, typename OT>
+    // Read array value as templated function on EPICS type
+    // (OPC UA type enum argument *must match* the EPICS type)
+    // Copies once, straight from the raw OpcUa_Variant array into the record buffer,
+    // numeric arrays of other types are converted element-wise (saturating)
+    template<typename ET>
     long
     readArray (ET *value, const epicsUInt32 num,
                epicsUInt32 *numRead,
@@ -817,7 +1201,7 @@ private:
         }
 
         ProcessReason nReason;
-        std::shared_ptr<UpdateUaSdk> upd = incomingQueue.popUpdate(&nReason);
+        std::shared_ptr<UpdateUaSdk> upd = popIncoming(&nReason);
         dbgReadArray(upd.get(), num, epicsTypeString(*value));
 
         switch (upd->getType()) {
@@ -845,20 +1229,29 @@ private:
                         errlogPrintf("%s : incoming data is not an array\n", prec->name);
                         (void) recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
                         ret = 1;
-                    } else if (data.type() != expectedType) {
-                        errlogPrintf("%s : incoming data type (%s) does not match EPICS array type (%s)\n",
-                                     prec->name, variantTypeString(data.type()), epicsTypeString(*value));
-                        (void) recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
-                        ret = 1;
-                    } else {
+                    } else if (data.type() == expectedType) {
                         if (OpcUa_IsUncertain(stat)) {
                             (void) recGblSetSevr(prec, READ_ALARM, MINOR_ALARM);
                         }
-                        OT arr;
-                        UaVariant_to(upd->getData(), arr);
-                        elemsWritten = num < arr.length() ? num : arr.length();
-                        memcpy(value, arr.rawData(), sizeof(ET) * elemsWritten);
+                        const OpcUa_Variant *v = data;
+                        elemsWritten = static_cast<epicsUInt32>(std::max<OpcUa_Int32>(0, v->Value.Array.Length));
+                        if (num < elemsWritten) elemsWritten = num;
+                        memcpy(value, v->Value.Array.Value.Array, sizeof(ET) * elemsWritten);
                         prec->udf = false;
+                    } else {
+                        bool clipped = false;
+                        if (!arrayFromVariant(*static_cast<const OpcUa_Variant *>(data),
+                                              value, num, elemsWritten, clipped)) {
+                            errlogPrintf("%s : incoming data type (%s) can not be converted to EPICS array type (%s)\n",
+                                         prec->name, variantTypeString(data.type()), epicsTypeString(*value));
+                            (void) recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
+                            ret = 1;
+                        } else {
+                            if (OpcUa_IsUncertain(stat) || clipped) {
+                                (void) recGblSetSevr(prec, READ_ALARM, MINOR_ALARM);
+                            }
+                            prec->udf = false;
+                        }
                     }
                 }
                 if (statusCode) *statusCode = stat;
@@ -893,6 +1286,7 @@ private:
                const epicsUInt32 statusTextLen);
 
     // Write scalar value as templated function on EPICS type
+    // (the writer for the OPC UA type is resolved once per incoming type and cached)
     template<typename ET>
     long
     writeScalar (const ET &value,
@@ -900,128 +1294,24 @@ private:
     {
         long ret = 0;
 
-        switch (incomingData.type()) {
-        case OpcUaType_Boolean:
-        { // Scope of Guard G
-            Guard G(outgoingLock);
-            isdirty = true;
-            if (value == 0)
-                outgoingData.setBoolean(false);
-            else
-                outgoingData.setBoolean(true);
-            break;
-        }
-        case OpcUaType_Byte:
-            if (isWithinRange<OpcUa_Byte>(value)) {
-                Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setByte(static_cast<OpcUa_Byte>(value));
-            } else {
-                (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-                ret = 1;
-            }
-            break;
-        case OpcUaType_SByte:
-            if (isWithinRange<OpcUa_SByte>(value)) {
-                Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setSByte(static_cast<OpcUa_SByte>(value));
-            } else {
-                (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-                ret = 1;
-            }
-            break;
-        case OpcUaType_UInt16:
-            if (isWithinRange<OpcUa_UInt16>(value)) {
-                Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setUInt16(static_cast<OpcUa_UInt16>(value));
-            } else {
-                (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-                ret = 1;
-            }
-            break;
-        case OpcUaType_Int16:
-            if (isWithinRange<OpcUa_Int16>(value)) {
-                Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setInt16(static_cast<OpcUa_Int16>(value));
-            } else {
-                (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-                ret = 1;
-            }
-            break;
-        case OpcUaType_UInt32:
-            if (isWithinRange<OpcUa_UInt32>(value)) {
-                Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setUInt32(static_cast<OpcUa_UInt32>(value));
-            } else {
-                (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-                ret = 1;
-            }
-            break;
-        case OpcUaType_Int32:
-            if (isWithinRange<OpcUa_Int32>(value)) {
-                Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setInt32(static_cast<OpcUa_Int32>(value));
-            } else {
-                (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-                ret = 1;
-            }
-            break;
-        case OpcUaType_UInt64:
-            if (isWithinRange<OpcUa_UInt64>(value)) {
-                Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setUInt64(static_cast<OpcUa_UInt64>(value));
-            } else {
-                (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-                ret = 1;
-            }
-            break;
-        case OpcUaType_Int64:
-            if (isWithinRange<OpcUa_Int64>(value)) {
-                Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setInt64(static_cast<OpcUa_Int64>(value));
-            } else {
-                (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-                ret = 1;
-            }
-            break;
-        case OpcUaType_Float:
-            if (isWithinRange<OpcUa_Float>(value)) {
+        typename ScalarWriter<ET>::Writer write =
+                converters(&value).writer.get(incomingType, &ScalarWriter<ET>::resolve);
+        if (!write) {
+            errlogPrintf("%s : unsupported conversion for outgoing data\n",
+                         prec->name);
+            (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
+        } else {
+            bool ok;
+            { // Scope of Guard G
                 Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setFloat(static_cast<OpcUa_Float>(value));
-            } else {
-                (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-                ret = 1;
+                ok = write(outgoingData, value);
+                if (ok)
+                    isdirty = true;
             }
-            break;
-        case OpcUaType_Double:
-            if (isWithinRange<OpcUa_Double>(value)) {
-                Guard G(outgoingLock);
-                isdirty = true;
-                outgoingData.setDouble(static_cast<OpcUa_Double>(value));
-            } else {
+            if (!ok) {
                 (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
                 ret = 1;
             }
-            break;
-        case OpcUaType_String:
-        { // Scope of Guard G
-            Guard G(outgoingLock);
-            isdirty = true;
-            outgoingData.setString(static_cast<UaString>(std::to_string(value).c_str()));
-            break;
-        }
-        default:
-            errlogPrintf("%s : unsupported conversion for outgoing data\n",
-                         prec->name);
-            (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
         }
 
         dbgWriteScalar();
@@ -1037,6 +1327,7 @@ private:
 
     // Write array value as templated function on EPICS type, OPC UA container and simple (element) types
     // (latter *must match* OPC UA type enum argument)
+    // Arrays for numeric OPC UA types that do not match are converted element-wise (range checked)
     // CAVEAT: changes must also be reflected in the specialization (in DataElementUaSdk.cpp)
     template<typename ET, typename CT, typename ST>
     long
@@ -1046,18 +1337,12 @@ private:
     {
         long ret = 0;
 
-        if (!incomingData.isArray()) {
+        if (!incomingIsArray) {
             errlogPrintf("%s : OPC UA data type is not an array\n", prec->name);
             (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
             ret = 1;
-        } else if (incomingData.type() != targetType) {
-            errlogPrintf("%s : OPC UA data type (%s) does not match expected type (%s) for EPICS array (%s)\n",
-                         prec->name,
-                         variantTypeString(incomingData.type()),
-                         variantTypeString(targetType),
-                         epicsTypeString(*value));
-            (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
-            ret = 1;
+        } else if (incomingType != targetType) {
+            ret = writeConvertedArray(value, num, prec);
         } else {
             // The array methods must cast away the constness of their value argument
             // as the UA SDK API uses non-const parameters
@@ -1074,6 +1359,47 @@ private:
         return ret;
     }
 
+    // Write array value converted element-wise to the (numeric) OPC UA type, range checked
+    template<typename ET>
+    long
+    writeConvertedArray (const ET *value, const epicsUInt32 num,
+                         dbCommon *prec)
+    {
+        long ret = 0;
+        OpcUa_Variant arr;
+        epicsUInt32 bad;
+
+        if (!arrayToVariant(arr, incomingType, value, num, bad)) {
+            errlogPrintf("%s : OPC UA data type (%s) can not be converted from EPICS array (%s)\n",
+                         prec->name,
+                         variantTypeString(incomingType),
+                         epicsTypeString(*value));
+            (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
+            ret = 1;
+        } else if (bad < num) {
+            errlogPrintf("%s : element %u of EPICS array (%s) out of range for OPC UA data type (%s)\n",
+                         prec->name, bad,
+                         epicsTypeString(*value),
+                         variantTypeString(incomingType));
+#if defined(VERSION_INT) && EPICS_VERSION_INT >= VERSION_INT(7,0,6,0)
+            (void) recGblSetSevrMsg(prec, WRITE_ALARM, INVALID_ALARM, "element %u out of range", bad);
+#else
+            (void) recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
+#endif
+            ret = 1;
+        } else {
+            { // Scope of Guard G
+                Guard G(outgoingLock);
+                isdirty = true;
+                outgoingData.clear();
+                outgoingData.attach(&arr);
+            }
+
+            dbgWriteArray(num, epicsTypeString(*value));
+        }
+        return ret;
+    }
+
     ItemUaSdk *pitem;                                       /**< corresponding item */
     std::vector<std::weak_ptr<DataElementUaSdk>> elements;  /**< children (if node) */
     std::shared_ptr<DataElementUaSdk> parent;               /**< parent */
@@ -1081,11 +1407,18 @@ private:
     std::unordered_map<int, std::weak_ptr<DataElementUaSdk>> elementMap;
 
     bool mapped;                             /**< child name to index mapping done */
-    UpdateQueue<UpdateUaSdk> incomingQueue;  /**< queue of incoming values */
-    UaVariant incomingData;                  /**< cache of latest incoming value */
+    BlockPool updatePool;                    /**< recycled memory for updates (must outlive the queue) */
+    RingUpdateQueue<UpdateUaSdk> incomingQueue; /**< queue of incoming values */
+    UaVariant incomingData;                  /**< cache of latest incoming value (node only) */
+    OpcUa_BuiltInType incomingType;          /**< type of latest incoming value */
+    bool incomingIsArray;                    /**< latest incoming value is an array */
     epicsMutex outgoingLock;                 /**< data lock for outgoing value */
     UaVariant outgoingData;                  /**< cache of latest outgoing value */
     bool isdirty;                            /**< outgoing value has been (or needs to be) updated */
+    ScalarConverters<epicsInt32, OpcUa_Int32> convInt32;      /**< cached converters for epicsInt32 */
+    ScalarConverters<epicsUInt32, OpcUa_UInt32> convUInt32;   /**< cached converters for epicsUInt32 */
+    ScalarConverters<epicsInt64, OpcUa_Int64> convInt64;      /**< cached converters for epicsInt64 */
+    ScalarConverters<epicsFloat64, OpcUa_Double> convFloat64; /**< cached converters for epicsFloat64 */
 };
 
 } // namespace DevOpcua
@@ -47,7 +47,13 @@ ItemUaSdk::ItemUaSdk(const linkInfo &info)
     , lastStatus(OpcUa_BadServerNotConnected)
     , lastReason(ProcessReason::connectionLoss)
     , connState(ConnectionStatus::down)
+    , readQueued(0)
+    , lastValueSize(0)
+    , readCargo(std::make_shared<ReadRequest>())
+    , writeCargo(std::make_shared<WriteRequest>())
 {
+    readCargo->item = this;
+    writeCargo->item = this;
     if (linkinfo.subscription != "" && linkinfo.monitor) {
         subscription = SubscriptionUaSdk::find(linkinfo.subscription);
         subscription->addItemUaSdk(this);
@@ -104,6 +110,8 @@ ItemUaSdk::show (int level) const
               << " bini=" << linkOptionBiniString(linkinfo.bini)
               << " output=" << (linkinfo.isOutput ? "y" : "n")
               << " monitor=" << (linkinfo.monitor ? "y" : "n")
+              << " drain=" << (linkinfo.drainQueue ? "y" : "n")
+              << " maxage=" << linkinfo.maxAge
               << " registered=" << (registered ? nodeid->toString().toUtf8() : "-" )
               << "(" << (linkinfo.registerNode ? "y" : "n") << ")"
               << std::endl;
@@ -171,6 +179,7 @@ ItemUaSdk::setIncomingData(const OpcUa_DataValue &value, ProcessReason reason)
                      (linkinfo.identifierIsNumeric ? "" : linkinfo.identifierString.c_str()));
 
     setLastStatus(value.StatusCode);
+    epics::atomic::set(lastValueSize, variantEncodedSize(value.Value));
 
     if (auto pd = dataTree.root().lock())
         pd->setIncomingData(value.Value, reason);
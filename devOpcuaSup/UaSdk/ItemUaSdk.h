@@ -21,6 +21,7 @@
 #include <uastructuredefinition.h>
 
 #include <epicsTime.h>
+#include <epicsAtomic.h>
 
 #include "Item.h"
 #include "opcuaItemRecord.h"
@@ -116,6 +117,93 @@ public:
      */
     UaNodeId &getNodeId() const { return (*nodeid); }
 
+    /**
+     * @brief Mark the item as having a read request in the reader queue.
+     *
+     * Used by the session to merge read requests for the same item
+     * that come in while a read is already queued (but not yet sent).
+     * The mark holds the highest priority the read has been queued with:
+     * a request with a higher priority raises it and has to be queued
+     * (again) with that priority.
+     *
+     * @param priority  priority of the new read request
+     *
+     * @return true if a read request was already queued with the same or a higher
+     *         priority (new request can be merged)
+     */
+    bool markReadQueued(const int priority)
+    {
+        const int mark = priority + 1;
+        int current = epics::atomic::get(readQueued);
+        while (current < mark) {
+            const int previous = epics::atomic::compareAndSwap(readQueued, current, mark);
+            if (previous == current)
+                return false;
+            current = previous;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Take the read request queued mark.
+     *
+     * Called by the session when a queued read request is being sent.
+     * A read that was queued again with a higher priority has more than one
+     * request in the queue: the first one to be taken sends the read,
+     * the others find the mark cleared and are skipped.
+     *
+     * @return true if the mark was set (read has to be sent)
+     */
+    bool takeReadQueued()
+    {
+        int current = epics::atomic::get(readQueued);
+        while (current) {
+            const int previous = epics::atomic::compareAndSwap(readQueued, current, 0);
+            if (previous == current)
+                return true;
+            current = previous;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Clear the read request queued mark.
+     *
+     * Called by the session when the queued read requests are discarded.
+     */
+    void clearReadQueued() { epics::atomic::set(readQueued, 0); }
+
+    /**
+     * @brief Get the (estimated) encoded size of the item's value.
+     *
+     * Based on the last value received from the server,
+     * used as expected size when batching read requests.
+     *
+     * @return size of the value [bytes]
+     */
+    size_t valueSize() const { return epics::atomic::get(lastValueSize); }
+
+    /**
+     * @brief Access the (reusable) read request cargo of this item.
+     *
+     * Created with the item. As reads are merged while queued,
+     * an item has only one read request in the queue per priority.
+     *
+     * @return reference to shared_ptr to the read request
+     */
+    std::shared_ptr<ReadRequest> &readRequest() { return readCargo; }
+
+    /**
+     * @brief Access the (reusable) write request cargo of this item.
+     *
+     * Created with the item, reused when not referenced by the writer
+     * queue or batch any more (otherwise replaced by the session,
+     * holding its write lock).
+     *
+     * @return reference to shared_ptr to the write request
+     */
+    std::shared_ptr<WriteRequest> &writeRequest() { return writeCargo; }
+
     /**
      * @brief Setter for the status of a read operation.
      * @param status  status code received by the client library
@@ -141,12 +229,12 @@ public:
     ProcessReason getReason() { return lastReason; }
 
     /**
-     * @brief Get a structure definition from the session dictionary.
+     * @brief Get a resolved structure definition from the session cache.
      * @param dataTypeId data type of the extension object
-     * @return structure definition
+     * @return shared pointer to the structure info, nullptr if not available
      */
-    UaStructureDefinition structureDefinition(const UaNodeId &dataTypeId)
-    { return session->structureDefinition(dataTypeId); }
+    std::shared_ptr<const StructureInfo> structureInfo(const UaNodeId &dataTypeId)
+    { return session->structureInfo(dataTypeId); }
 
     /**
      * @brief Get the outgoing data value.
@@ -228,6 +316,10 @@ private:
     UaStatusCode lastStatus;               /**< status code of most recent service */
     ProcessReason lastReason;              /**< most recent processing reason */
     ConnectionStatus connState;            /**< Connection state of the item */
+    int readQueued;                        /**< read request in reader queue (highest priority + 1, 0 = none) */
+    size_t lastValueSize;                  /**< encoded size of last received value */
+    std::shared_ptr<ReadRequest> readCargo;   /**< reusable read request */
+    std::shared_ptr<WriteRequest> writeCargo; /**< reusable write request */
     epicsTime tsClient;                    /**< client (local) time stamp */
     epicsTime tsServer;                    /**< server time stamp */
     epicsTime tsSource;                    /**< device time stamp */
@@ -66,15 +66,30 @@ void
 Session::showOptionHelp ()
 {
     std::cout << "Options:\n"
-              << "clientcert         path to client certificate [none]\n"
-              << "clientkey          path to client private key [none]\n"
-              << "nodes-max          max. nodes per service call [0 = no limit]\n"
-              << "read-nodes-max     max. nodes per read service call [0 = no limit]\n"
-              << "read-timeout-min   min. timeout (holdoff) after read service call [ms]\n"
-              << "read-timeout-max   timeout (holdoff) after read service call w/ max elements [ms]\n"
-              << "write-nodes-max    max. nodes per write service call [0 = no limit]\n"
-              << "write-timeout-min  min. timeout (holdoff) after write service call [ms]\n"
-              << "write-timeout-max  timeout (holdoff) after write service call w/ max elements [ms]"
+              << "clientcert            path to client certificate [none]\n"
+              << "clientkey             path to client private key [none]\n"
+              << "nodes-max             max. nodes per service call [0 = no limit]\n"
+              << "calls-per-sec         max. rate of read and write service calls [1/s; 0 = no limit]\n"
+              << "nodes-per-sec         max. rate of nodes in read and write service calls [1/s; 0 = no limit]\n"
+              << "read-nodes-max        max. nodes per read service call [0 = no limit]\n"
+              << "read-timeout-min      min. timeout (holdoff) after read service call [ms]\n"
+              << "read-timeout-max      timeout (holdoff) after read service call w/ max elements [ms]\n"
+              << "read-latency-target   adaptive batching: target for read service round trip [ms; 0 = off]\n"
+              << "read-inflight-max     max. outstanding read service calls [0 = no limit; disables holdoff]\n"
+              << "read-weights          weighted fair scheduling low:medium:high (e.g. 1:2:4) [strict priority]\n"
+              << "read-age-limit        hold back partial read batches for up to [ms; 0 = send immediately]\n"
+              << "read-express          send HIGH priority reads immediately (bypass holdoff/window) [n]\n"
+              << "read-bytes-max        max. (estimated) response size per read service call [bytes; 0 = no limit]\n"
+              << "write-nodes-max       max. nodes per write service call [0 = no limit]\n"
+              << "write-timeout-min     min. timeout (holdoff) after write service call [ms]\n"
+              << "write-timeout-max     timeout (holdoff) after write service call w/ max elements [ms]\n"
+              << "write-latency-target  adaptive batching: target for write service round trip [ms; 0 = off]\n"
+              << "write-inflight-max    max. outstanding write service calls [0 = no limit; disables holdoff]\n"
+              << "write-weights         weighted fair scheduling low:medium:high (e.g. 1:2:4) [strict priority]\n"
+              << "write-age-limit       hold back partial write batches for up to [ms; 0 = send immediately]\n"
+              << "write-express         send HIGH priority writes immediately (bypass holdoff/window) [n]\n"
+              << "write-bytes-max       max. (estimated) request size per write service call [bytes; 0 = no limit]\n"
+              << "write-coalesce        queued (unsent) write to same item is replaced by newer value [n]"
               << std::endl;
 }
 
@@ -12,12 +12,14 @@
  */
 
 #include <iostream>
+#include <atomic>
 #include <string>
 #include <map>
 #include <algorithm>
 #include <utility>
 #include <vector>
 #include <limits>
+#include <cstring>
 
 #include <uaclientsdk.h>
 #include <uasession.h>
@@ -46,17 +48,6 @@ static epicsThreadOnceId session_uasdk_atexit_once = EPICS_THREAD_ONCE_INIT;
 
 Registry<SessionUaSdk> SessionUaSdk::sessions;
 
-// Cargo structure and batcher for write requests
-struct WriteRequest {
-    ItemUaSdk *item;
-    OpcUa_WriteValue wvalue;
-};
-
-// Cargo structure and batcher for read requests
-struct ReadRequest {
-    ItemUaSdk *item;
-};
-
 static
 void session_uasdk_ihooks_register (void *junk)
 {
@@ -71,6 +62,36 @@ void session_uasdk_atexit_register (void *junk)
     epicsAtExit(SessionUaSdk::atExit, nullptr);
 }
 
+// Parse scheduling weights "low:medium:high" (missing values are 0)
+static void
+parseWeights (const std::string &value, unsigned int (&weights)[menuPriority_NUM_CHOICES])
+{
+    const char *p = value.c_str();
+    char *end;
+    for (int prio = menuPriorityLOW; prio < menuPriority_NUM_CHOICES; prio++) {
+        weights[prio] = static_cast<unsigned int>(std::strtoul(p, &end, 0));
+        p = end;
+        if (*p == ':' || *p == ',') p++;
+    }
+}
+
+// Print queue statistics of a batcher
+template<typename T>
+static void
+showQueueStats (const char *prefix, const RequestQueueBatcher<T> &batcher)
+{
+    static const char *prioName[menuPriority_NUM_CHOICES] = { "LOW", "MEDIUM", "HIGH" };
+    std::cout << prefix << " queue wait (count/avg/max):";
+    for (int prio = menuPriority_NUM_CHOICES-1; prio >= menuPriorityLOW; prio--) {
+        menuPriority p = static_cast<menuPriority>(prio);
+        std::cout << " " << prioName[prio] << "="
+                  << batcher.dequeued(p) << "/"
+                  << batcher.averageWait(p) << "/"
+                  << batcher.maxWait(p) << "ms";
+    }
+    std::cout << std::endl;
+}
+
 inline const char *
 serverStatusString (UaClient::ServerStatus type)
 {
@@ -96,14 +117,19 @@ SessionUaSdk::SessionUaSdk (const std::string &name, const std::string &serverUr
     , puasession(new UaSession())
     , serverConnectionStatus(UaClient::Disconnected)
     , transactionId(0)
+    , readsMerged(0)
     , writer("OPCwr-" + name, *this, batchNodes)
     , writeNodesMax(0)
     , writeTimeoutMin(0)
     , writeTimeoutMax(0)
+    , writeLatencyTarget(0)
+    , writeCoalesce(false)
+    , writesCoalesced(0)
     , reader("OPCrd-" + name, *this, batchNodes)
     , readNodesMax(0)
     , readTimeoutMin(0)
     , readTimeoutMax(0)
+    , readLatencyTarget(0)
 {
     int status;
     char host[256] = { 0 };
@@ -123,6 +149,10 @@ SessionUaSdk::SessionUaSdk (const std::string &name, const std::string &serverUr
 
     connectInfo.typeDictionaryMode = UaClientSdk::UaClient::ReadTypeDictionaries_Reconnect;
 
+    // Rate limits are shared by reader and writer
+    reader.setRateLimiters(&callLimiter, &nodeLimiter);
+    writer.setRateLimiters(&callLimiter, &nodeLimiter);
+
     //TODO: init security settings
     if ((clientCertificate && (clientCertificate[0] != '\0'))
             || (clientPrivateKey && (clientPrivateKey[0] != '\0')))
@@ -165,6 +195,12 @@ SessionUaSdk::setOption (const std::string &name, const std::string &value)
         connectInfo.nMaxOperationsPerServiceCall = ul;
         updateReadBatcher = true;
         updateWriteBatcher = true;
+    } else if (name == "calls-per-sec") {
+        double d = std::strtod(value.c_str(), nullptr);
+        callLimiter.setRate(d);
+    } else if (name == "nodes-per-sec") {
+        double d = std::strtod(value.c_str(), nullptr);
+        nodeLimiter.setRate(d);
     } else if (name == "read-nodes-max") {
         unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
         readNodesMax = ul;
@@ -177,6 +213,25 @@ SessionUaSdk::setOption (const std::string &name, const std::string &value)
         unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
         readTimeoutMax = ul;
         updateReadBatcher = true;
+    } else if (name == "read-latency-target") {
+        unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
+        readLatencyTarget = ul;
+        updateReadBatcher = true;
+    } else if (name == "read-inflight-max") {
+        unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
+        reader.setWindow(static_cast<unsigned int>(ul));
+    } else if (name == "read-age-limit") {
+        unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
+        reader.setAgeLimit(static_cast<unsigned int>(ul));
+    } else if (name == "read-express") {
+        reader.setExpress(value.length() > 0 && strchr("YyTt1", value[0]));
+    } else if (name == "read-bytes-max") {
+        unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
+        reader.setMaxBytes(ul);
+    } else if (name == "read-weights") {
+        unsigned int weights[menuPriority_NUM_CHOICES];
+        parseWeights(value, weights);
+        reader.setWeights(weights);
     } else if (name == "write-nodes-max") {
         unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
         writeNodesMax = ul;
@@ -189,6 +244,27 @@ SessionUaSdk::setOption (const std::string &name, const std::string &value)
         unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
         writeTimeoutMax = ul;
         updateWriteBatcher = true;
+    } else if (name == "write-latency-target") {
+        unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
+        writeLatencyTarget = ul;
+        updateWriteBatcher = true;
+    } else if (name == "write-inflight-max") {
+        unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
+        writer.setWindow(static_cast<unsigned int>(ul));
+    } else if (name == "write-age-limit") {
+        unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
+        writer.setAgeLimit(static_cast<unsigned int>(ul));
+    } else if (name == "write-express") {
+        writer.setExpress(value.length() > 0 && strchr("YyTt1", value[0]));
+    } else if (name == "write-bytes-max") {
+        unsigned long ul = std::strtoul(value.c_str(), nullptr, 0);
+        writer.setMaxBytes(ul);
+    } else if (name == "write-weights") {
+        unsigned int weights[menuPriority_NUM_CHOICES];
+        parseWeights(value, weights);
+        writer.setWeights(weights);
+    } else if (name == "write-coalesce") {
+        writeCoalesce = (value.length() > 0 && strchr("YyTt1", value[0]));
     } else {
         errlogPrintf("unknown option '%s' ignored\n", name.c_str());
     }
@@ -199,14 +275,28 @@ SessionUaSdk::setOption (const std::string &name, const std::string &value)
     } else {
         max = connectInfo.nMaxOperationsPerServiceCall + readNodesMax;
     }
-    if (updateReadBatcher) reader.setParams(max, readTimeoutMin, readTimeoutMax);
+    // A new batch size configuration replaces the learned caps
+    const bool resetReadCap = (name == "batch-nodes" || name == "nodes-max" || name == "read-nodes-max");
+    const bool resetWriteCap = (name == "batch-nodes" || name == "nodes-max" || name == "write-nodes-max");
+
+    if (updateReadBatcher) {
+        reader.setParams(max, readTimeoutMin, readTimeoutMax);
+        reader.setLatencyTarget(readLatencyTarget);
+    }
+    if (resetReadCap)
+        reader.setRequestsCap(0);
 
     if (connectInfo.nMaxOperationsPerServiceCall > 0 && writeNodesMax > 0) {
         max = std::min<unsigned int>(connectInfo.nMaxOperationsPerServiceCall, writeNodesMax);
     } else {
         max = connectInfo.nMaxOperationsPerServiceCall + writeNodesMax;
     }
-    if (updateWriteBatcher) writer.setParams(max, writeTimeoutMin, writeTimeoutMax);
+    if (updateWriteBatcher) {
+        writer.setParams(max, writeTimeoutMin, writeTimeoutMax);
+        writer.setLatencyTarget(writeLatencyTarget);
+    }
+    if (resetWriteCap)
+        writer.setRequestsCap(0);
 }
 
 long
@@ -282,9 +372,16 @@ SessionUaSdk::isConnected () const
 void
 SessionUaSdk::requestRead (ItemUaSdk &item)
 {
-    auto cargo = std::make_shared<ReadRequest>();
-    cargo->item = &item;
-    reader.pushRequest(cargo, item.recConnector->getRecordPriority());
+    // A read for this item is already queued (with the same or a higher priority):
+    // its result will be fanned out to all data elements (and their waiting records)
+    // by setIncomingData()
+    // Otherwise (also if it is queued with a lower priority) queue the read
+    const menuPriority priority = item.recConnector->getRecordPriority();
+    if (item.markReadQueued(priority)) {
+        epics::atomic::increment(readsMerged);
+        return;
+    }
+    reader.pushRequest(item.readRequest(), priority);
 }
 
 // Low level reader function called by the RequestQueueBatcher
@@ -292,12 +389,26 @@ void
 SessionUaSdk::processRequests (std::vector<std::shared_ptr<ReadRequest>> &batch)
 {
     UaStatus status;
-    UaReadValueIds nodesToRead;
-    std::unique_ptr<std::vector<ItemUaSdk *>> itemsToRead(new std::vector<ItemUaSdk *>);
+    UaReadValueIds &nodesToRead = readValueIds;
     ServiceSettings serviceSettings;
+
+    // Skip requests for reads that have already been sent
+    // (through a request that was queued again with a higher priority)
+    batch.erase(std::remove_if(batch.begin(), batch.end(),
+                               [] (const std::shared_ptr<ReadRequest> &c) { return !c->item->takeReadQueued(); }),
+                batch.end());
+    const unsigned int generation = reader.batchGeneration();
+    if (batch.empty()) {
+        reader.completeBatch(generation);
+        return;
+    }
+
+    std::unique_ptr<std::vector<ItemUaSdk *>> itemsToRead(getItemVector(batch.size()));
     OpcUa_UInt32 id = getTransactionId();
 
-    nodesToRead.create(static_cast<OpcUa_UInt32>(batch.size()));
+    // Only reallocate the request array if the batch size has changed
+    if (nodesToRead.length() != batch.size())
+        nodesToRead.create(static_cast<OpcUa_UInt32>(batch.size()));
     OpcUa_UInt32 i = 0;
     for (auto c : batch) {
         c->item->getNodeId().copyTo(&nodesToRead[i].NodeId);
@@ -317,8 +428,8 @@ SessionUaSdk::processRequests (std::vector<std::shared_ptr<ReadRequest>> &batch)
 	    if (status.isBad()) {
 	        errlogPrintf("OPC UA session %s: (requestRead) beginRead service failed with status %s\n",
 	                     name.c_str(), status.toString().toUtf8());
-            //TODO: create writeFailure events for all items of the batch
-//	        item.setIncomingEvent(ProcessReason::readFailure);
+            reader.completeBatch(generation);
+            retryOrFailReads(batch, status);
 
         } else {
             if (debug >= 5)
@@ -326,19 +437,78 @@ SessionUaSdk::processRequests (std::vector<std::shared_ptr<ReadRequest>> &batch)
                           << ": (requestRead) beginRead service ok"
                           << " (transaction id " << id
                           << "; retrieving " << nodesToRead.length() << " nodes)" << std::endl;
-            outstandingOps.insert(std::pair<OpcUa_UInt32, std::unique_ptr<std::vector<ItemUaSdk *>>>
-                                  (id, std::move(itemsToRead)));
+            outstandingOps.insert(std::pair<OpcUa_UInt32, OutstandingOp>
+                                  (id, OutstandingOp(std::move(itemsToRead), generation)));
         }
+    } else {
+        reader.completeBatch(generation);
+        retryOrFailReads(batch, UaStatus(OpcUa_BadServerNotConnected));
     }
+    if (itemsToRead)
+        releaseItemVector(std::move(itemsToRead));
+    for (i = 0; i < nodesToRead.length(); i++)
+        OpcUa_ReadValueId_Clear(&nodesToRead[i]);
 }
 
-void
-SessionUaSdk::requestWrite (ItemUaSdk &item)
+// Estimated encoding overhead of one node in a read/write request and response
+// (node id, attribute id, data value header), plus the length of string identifiers
+static size_t
+requestOverhead (const ItemUaSdk &item)
 {
-    auto cargo = std::make_shared<WriteRequest>();
-    cargo->item = &item;
+    return 32 + (item.linkinfo.identifierIsNumeric ? 0 : item.linkinfo.identifierString.length());
+}
+
+// Snapshot the outgoing data of an item into write request cargo
+// (reusing the item's cargo if it is not referenced by the writer any more)
+// writelock must be held (several threads may write to the same item)
+static std::shared_ptr<WriteRequest>
+makeWriteRequest (ItemUaSdk &item)
+{
+    std::shared_ptr<WriteRequest> &cargo = item.writeRequest();
+    if (cargo.use_count() == 1) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        OpcUa_Variant_Clear(&cargo->wvalue.Value.Value);
+        cargo->cost = 0;
+    } else {
+        cargo = std::make_shared<WriteRequest>();
+        cargo->item = &item;
+    }
     item.getOutgoingData().copyTo(&cargo->wvalue.Value.Value);
     item.clearOutgoingData();
+    return cargo;
+}
+
+void
+SessionUaSdk::requestWrite (ItemUaSdk &item)
+{
+    std::shared_ptr<WriteRequest> cargo;
+    { // Scope for write guard
+        Guard G(writelock);
+        if (writeCoalesce) {
+            auto it = queuedWrites.find(&item);
+            if (it != queuedWrites.end()) {
+                WriteRequest &queued = *it->second;
+                // Last value wins: replace the payload of the queued (not yet sent) write;
+                // writeComplete is delivered to all data elements of the item
+                // (unless its cost has been accounted for a batch and the new value is larger)
+                const OpcUa_Variant *value = item.getOutgoingData();
+                if (!queued.cost || requestOverhead(item) + variantEncodedSize(*value) <= queued.cost) {
+                    OpcUa_Variant_Clear(&queued.wvalue.Value.Value);
+                    item.getOutgoingData().copyTo(&queued.wvalue.Value.Value);
+                    item.clearOutgoingData();
+                    writesCoalesced++;
+                    return;
+                }
+                cargo = makeWriteRequest(item);
+                it->second = cargo;
+            } else {
+                cargo = makeWriteRequest(item);
+                queuedWrites.insert({&item, cargo});
+            }
+        } else {
+            cargo = makeWriteRequest(item);
+        }
+    }
     writer.pushRequest(cargo, item.recConnector->getRecordPriority());
 }
 
@@ -347,19 +517,32 @@ void
 SessionUaSdk::processRequests (std::vector<std::shared_ptr<WriteRequest>> &batch)
 {
     UaStatus status;
-    UaWriteValues nodesToWrite;
-    std::unique_ptr<std::vector<ItemUaSdk *>> itemsToWrite(new std::vector<ItemUaSdk *>);
+    UaWriteValues &nodesToWrite = writeValues;
+    std::unique_ptr<std::vector<ItemUaSdk *>> itemsToWrite(getItemVector(batch.size()));
     ServiceSettings serviceSettings;
     OpcUa_UInt32 id = getTransactionId();
+    const unsigned int generation = writer.batchGeneration();
 
-    nodesToWrite.create(static_cast<OpcUa_UInt32>(batch.size()));
-    OpcUa_UInt32 i = 0;
-    for (auto c : batch) {
-        c->item->getNodeId().copyTo(&nodesToWrite[i].NodeId);
-        nodesToWrite[i].AttributeId = OpcUa_Attributes_Value;
-        nodesToWrite[i].Value.Value = c->wvalue.Value.Value;
-        itemsToWrite->push_back(c->item);
-        i++;
+    // Only reallocate the request array if the batch size has changed
+    if (nodesToWrite.length() != batch.size())
+        nodesToWrite.create(static_cast<OpcUa_UInt32>(batch.size()));
+    { // Scope for write guard (coalescing requestWrite may replace payload until here)
+        Guard G(writelock);
+        OpcUa_UInt32 i = 0;
+        for (auto c : batch) {
+            if (!queuedWrites.empty()) {
+                auto it = queuedWrites.find(c->item);
+                if (it != queuedWrites.end() && it->second == c)
+                    queuedWrites.erase(it);
+            }
+            c->item->getNodeId().copyTo(&nodesToWrite[i].NodeId);
+            nodesToWrite[i].AttributeId = OpcUa_Attributes_Value;
+            // Move the payload (the request array owns it from here on)
+            nodesToWrite[i].Value.Value = c->wvalue.Value.Value;
+            OpcUa_Variant_Initialize(&c->wvalue.Value.Value);
+            itemsToWrite->push_back(c->item);
+            i++;
+        }
     }
 
     if (isConnected()) {
@@ -371,8 +554,8 @@ SessionUaSdk::processRequests (std::vector<std::shared_ptr<WriteRequest>> &batch
 	    if (status.isBad()) {
 	        errlogPrintf("OPC UA session %s: (requestWrite) beginWrite service failed with status %s\n",
 	                     name.c_str(), status.toString().toUtf8());
-            //TODO: create writeFailure events for all items of the batch
-//	        item.setIncomingEvent(ProcessReason::writeFailure);
+            writer.completeBatch(generation);
+            retryOrFailWrites(batch, status);
 
         } else {
             if (debug >= 5)
@@ -380,12 +563,170 @@ SessionUaSdk::processRequests (std::vector<std::shared_ptr<WriteRequest>> &batch
                           << ": (requestWrite) beginWrite service ok"
                           << " (transaction id " << id
                           << "; writing " << nodesToWrite.length() << " nodes)" << std::endl;
-            outstandingOps.insert(std::pair<OpcUa_UInt32, std::unique_ptr<std::vector<ItemUaSdk *>>>
-                                  (id, std::move(itemsToWrite)));
+            outstandingOps.insert(std::pair<OpcUa_UInt32, OutstandingOp>
+                                  (id, OutstandingOp(std::move(itemsToWrite), generation)));
         }
+    } else {
+        writer.completeBatch(generation);
+        retryOrFailWrites(batch, UaStatus(OpcUa_BadServerNotConnected));
+    }
+    if (itemsToWrite)
+        releaseItemVector(std::move(itemsToWrite));
+    for (OpcUa_UInt32 i = 0; i < nodesToWrite.length(); i++)
+        OpcUa_WriteValue_Clear(&nodesToWrite[i]);
+}
+
+// Status codes signalling that a service call exceeded server or encoding limits
+// (i.e., a smaller batch has a chance to succeed)
+static bool
+isLimitError (const UaStatus &status)
+{
+    switch (status.code() & 0xFFFF0000) {
+    case OpcUa_BadTooManyOperations:
+    case OpcUa_BadEncodingLimitsExceeded:
+    case OpcUa_BadRequestTooLarge:
+    case OpcUa_BadResponseTooLarge:
+        return true;
+    default:
+        return false;
     }
 }
 
+// Learn a lower batch size limit after a batch of the specified size was rejected
+// Returns true if the batch can be retried with smaller batches
+template<typename T>
+static bool
+learnBatchLimit (RequestQueueBatcher<T> &batcher, const size_t batchSize,
+                 const std::string &session, const char *kind)
+{
+    if (batchSize <= 1)
+        return false;
+    unsigned int cap = static_cast<unsigned int>(batchSize / 2);
+    if (!batcher.getRequestsCap() || batcher.getRequestsCap() > cap) {
+        batcher.setRequestsCap(cap);
+        errlogPrintf("OPC UA session %s: limiting %s batches to %u nodes\n",
+                     session.c_str(), kind, cap);
+    }
+    return true;
+}
+
+void
+SessionUaSdk::retryOrFailReads (std::vector<std::shared_ptr<ReadRequest>> &batch,
+                                const UaStatus &status)
+{
+    if (isLimitError(status) && learnBatchLimit(reader, batch.size(), name, "read")) {
+        // Re-queue (bisected through the lowered limit)
+        for (auto &c : batch) {
+            const menuPriority priority = c->item->recConnector->getRecordPriority();
+            if (c->item->markReadQueued(priority))
+                epics::atomic::increment(readsMerged);
+            else
+                reader.pushRequest(c, priority);
+        }
+    } else {
+        for (auto &c : batch) {
+            c->item->setIncomingEvent(ProcessReason::readFailure);
+            // Not doing initial write if the read has failed
+            c->item->setState(ConnectionStatus::up);
+        }
+    }
+}
+
+void
+SessionUaSdk::retryOrFailWrites (std::vector<std::shared_ptr<WriteRequest>> &batch,
+                                 const UaStatus &status)
+{
+    if (isLimitError(status) && learnBatchLimit(writer, batch.size(), name, "write")) {
+        // Re-queue (bisected through the lowered limit)
+        OpcUa_UInt32 i = 0;
+        for (auto &c : batch) {
+            // Move the payload back from the request array
+            c->wvalue.Value.Value = writeValues[i].Value.Value;
+            OpcUa_Variant_Initialize(&writeValues[i].Value.Value);
+            i++;
+            if (writeCoalesce) {
+                Guard G(writelock);
+                if (queuedWrites.count(c->item)) {
+                    // A newer value is queued: drop the old one
+                    OpcUa_Variant_Clear(&c->wvalue.Value.Value);
+                    writesCoalesced++;
+                    continue;
+                }
+                queuedWrites.insert({c->item, c});
+            }
+            writer.pushRequest(c, c->item->recConnector->getRecordPriority());
+        }
+    } else {
+        for (auto &c : batch) {
+            c->item->setIncomingEvent(ProcessReason::writeFailure);
+            c->item->setState(ConnectionStatus::up);
+        }
+    }
+}
+
+size_t
+SessionUaSdk::requestCost (const ReadRequest &cargo)
+{
+    return requestOverhead(*cargo.item) + cargo.item->valueSize();
+}
+
+size_t
+SessionUaSdk::requestCost (const WriteRequest &cargo)
+{
+    Guard G(writelock); // coalescing requestWrite may replace payload
+    cargo.cost = requestOverhead(*cargo.item) + variantEncodedSize(cargo.wvalue.Value.Value);
+    return cargo.cost;
+}
+
+std::unique_ptr<std::vector<ItemUaSdk *>>
+SessionUaSdk::getItemVector (const size_t size)
+{
+    std::unique_ptr<std::vector<ItemUaSdk *>> v;
+    {
+        Guard G(opslock);
+        if (!spareItemVectors.empty()) {
+            v = std::move(spareItemVectors.back());
+            spareItemVectors.pop_back();
+        }
+    }
+    if (!v)
+        v.reset(new std::vector<ItemUaSdk *>);
+    v->reserve(size);
+    return v;
+}
+
+void
+SessionUaSdk::releaseItemVector (std::unique_ptr<std::vector<ItemUaSdk *>> &&v)
+{
+    Guard G(opslock);
+    if (spareItemVectors.size() < maxSpareItemVectors) {
+        v->clear();
+        spareItemVectors.push_back(std::move(v));
+    } else {
+        v.reset();
+    }
+}
+
+std::shared_ptr<const StructureInfo>
+SessionUaSdk::structureInfo (const UaNodeId &dataTypeId)
+{
+    Guard G(structureLock);
+    auto it = structureCache.find(dataTypeId);
+    if (it != structureCache.end())
+        return it->second;
+
+    UaStructureDefinition definition = puasession->structureDefinition(dataTypeId);
+    if (definition.isNull())
+        return nullptr;
+    auto info = std::make_shared<const StructureInfo>(definition);
+    structureCache.insert({dataTypeId, info});
+    if (debug >= 5)
+        std::cout << "Session " << name.c_str()
+                  << ": (structureInfo) cached definition for " << dataTypeId.toXmlString().toUtf8()
+                  << " (" << definition.childrenCount() << " children)" << std::endl;
+    return info;
+}
+
 void
 SessionUaSdk::createAllSubscriptions ()
 {
@@ -516,11 +857,67 @@ SessionUaSdk::show (const int level) const
               << " items=" << items.size()
               << " registered=" << registeredItemsNo
               << " subscriptions=" << subscriptions.size()
+              << " merged-reads=" << readsMerged
               << " reader=" << reader.maxRequests() << "/"
               << reader.minHoldOff() << "-" << reader.maxHoldOff() << "ms"
               << " writer=" << writer.maxRequests() << "/"
-              << writer.minHoldOff() << "-" << writer.maxHoldOff() << "ms"
-              << std::endl;
+              << writer.minHoldOff() << "-" << writer.maxHoldOff() << "ms";
+    if (writeCoalesce)
+        std::cout << " coalesced-writes=" << writesCoalesced;
+    if (reader.getWeight(menuPriorityLOW))
+        std::cout << " reader-weights=" << reader.getWeight(menuPriorityLOW)
+                  << ":" << reader.getWeight(menuPriorityMEDIUM)
+                  << ":" << reader.getWeight(menuPriorityHIGH);
+    if (writer.getWeight(menuPriorityLOW))
+        std::cout << " writer-weights=" << writer.getWeight(menuPriorityLOW)
+                  << ":" << writer.getWeight(menuPriorityMEDIUM)
+                  << ":" << writer.getWeight(menuPriorityHIGH);
+    if (callLimiter.rate() > 0.0)
+        std::cout << " calls-per-sec=" << callLimiter.rate()
+                  << "(" << callLimiter.noOfThrottled() << "/" << callLimiter.noOfTakes()
+                  << " throttled, " << callLimiter.throttledSeconds() << "s)";
+    if (nodeLimiter.rate() > 0.0)
+        std::cout << " nodes-per-sec=" << nodeLimiter.rate()
+                  << "(" << nodeLimiter.noOfThrottled() << "/" << nodeLimiter.noOfTakes()
+                  << " throttled, " << nodeLimiter.throttledSeconds() << "s)";
+    if (reader.getExpress())
+        std::cout << " reader-express=" << reader.noOfExpressBatches()
+                  << "(" << reader.averageExpressWait() << "/" << reader.maxExpressWait() << "ms)";
+    if (writer.getExpress())
+        std::cout << " writer-express=" << writer.noOfExpressBatches()
+                  << "(" << writer.averageExpressWait() << "/" << writer.maxExpressWait() << "ms)";
+    if (reader.getRequestsCap())
+        std::cout << " reader-cap=" << reader.getRequestsCap();
+    if (writer.getRequestsCap())
+        std::cout << " writer-cap=" << writer.getRequestsCap();
+    if (reader.maxBytes())
+        std::cout << " reader-bytes-max=" << reader.maxBytes()
+                  << "(" << reader.budgetLimitedBatches() << " limited)";
+    if (writer.maxBytes())
+        std::cout << " writer-bytes-max=" << writer.maxBytes()
+                  << "(" << writer.budgetLimitedBatches() << " limited)";
+    if (reader.getAgeLimit())
+        std::cout << " reader-age-limit=" << reader.getAgeLimit() << "ms";
+    if (writer.getAgeLimit())
+        std::cout << " writer-age-limit=" << writer.getAgeLimit() << "ms";
+    if (reader.window())
+        std::cout << " reader-inflight=" << reader.outstandingBatches() << "/" << reader.window();
+    if (writer.window())
+        std::cout << " writer-inflight=" << writer.outstandingBatches() << "/" << writer.window();
+    if (reader.latencyTargetMs())
+        std::cout << " reader-adaptive=" << reader.currentMaxRequests() << "/"
+                  << reader.currentHoldOff() << "ms@" << reader.averageLatency()
+                  << "(" << reader.latencyTargetMs() << ")ms";
+    if (writer.latencyTargetMs())
+        std::cout << " writer-adaptive=" << writer.currentMaxRequests() << "/"
+                  << writer.currentHoldOff() << "ms@" << writer.averageLatency()
+                  << "(" << writer.latencyTargetMs() << ")ms";
+    std::cout << std::endl;
+
+    if (level >= 1) {
+        showQueueStats("  reader", reader);
+        showQueueStats("  writer", writer);
+    }
 
     if (level >= 3) {
         if (namespaceMap.size()) {
@@ -598,7 +995,12 @@ void SessionUaSdk::connectionStatusChanged (
     case UaClient::Disconnected:
         reader.clear();
         writer.clear();
+        {
+            Guard G(writelock);
+            queuedWrites.clear();
+        }
         for (auto it : items) {
+            it->clearReadQueued();
             it->setState(ConnectionStatus::down);
             it->setIncomingEvent(ProcessReason::connectionLoss);
         }
@@ -613,6 +1015,8 @@ void SessionUaSdk::connectionStatusChanged (
         // "The connection to the server is established and is working in normal mode."
     case UaClient::Connected:
         if (serverConnectionStatus == UaClient::Disconnected) {
+            reader.setRequestsCap(0);
+            writer.setRequestsCap(0);
             updateNamespaceMap(puasession->getNamespaceTable());
             rebuildNodeIds();
             registerNodes();
@@ -625,13 +1029,15 @@ void SessionUaSdk::connectionStatusChanged (
                           << ": triggering initial read for all "
                           << items.size() << " items" << std::endl;
             }
-            auto cargo = std::vector<std::shared_ptr<ReadRequest>>(items.size());
-            unsigned int i = 0;
+            auto cargo = std::vector<std::shared_ptr<ReadRequest>>();
+            cargo.reserve(items.size());
             for (auto it : items) {
                 it->setState(ConnectionStatus::initialRead);
-                cargo[i] = std::make_shared<ReadRequest>();
-                cargo[i]->item = it;
-                i++;
+                if (it->markReadQueued(menuPriorityHIGH)) {
+                    epics::atomic::increment(readsMerged);
+                    continue;
+                }
+                cargo.push_back(it->readRequest());
             }
             // status needs to be updated before requests are being issued
             serverConnectionStatus = serverStatus;
@@ -644,6 +1050,14 @@ void SessionUaSdk::connectionStatusChanged (
         // This requires to redo register nodes for the new session
         // or to read the namespace array."
     case UaClient::NewSessionCreated:
+        { // Scope of Guard G
+            // the type dictionary of the new session may differ
+            Guard G(structureLock);
+            structureCache.clear();
+        }
+        // so may the server limits: forget the learned batch size caps
+        reader.setRequestsCap(0);
+        writer.setRequestsCap(0);
         updateNamespaceMap(puasession->getNamespaceTable());
         rebuildNodeIds();
         registerNodes();
@@ -666,18 +1080,23 @@ SessionUaSdk::readComplete (OpcUa_UInt32 transactionId,
         errlogPrintf("OPC UA session %s: (readComplete) received a callback "
                      "with unknown transaction id %u - ignored\n",
                      name.c_str(), transactionId);
-    } else if (result.isGood()) {
+        return;
+    }
+    reader.reportLatency(epicsTime::getCurrent() - it->second.started, it->second.items->size());
+    reader.completeBatch(it->second.generation);
+    if (result.isGood()) {
+        reader.reportSuccess(it->second.items->size());
         if (debug >= 2)
             std::cout << "Session " << name.c_str()
                       << ": (readComplete) getting data for read service"
                       << " (transaction id " << transactionId
                       << "; data for " << values.length() << " items)" << std::endl;
-        if ((*it->second).size() != values.length())
+        if ((*it->second.items).size() != values.length())
             errlogPrintf("OPC UA session %s: (readComplete) received a callback "
                          "with %u values for a request containing %lu items\n",
-                         name.c_str(), values.length(), (*it->second).size());
+                         name.c_str(), values.length(), (*it->second.items).size());
         OpcUa_UInt32 i = 0;
-        for (auto item : (*it->second)) {
+        for (auto item : (*it->second.items)) {
             if (i >= values.length()) {
                 item->setIncomingEvent(ProcessReason::readFailure);
             } else {
@@ -693,6 +1112,7 @@ SessionUaSdk::readComplete (OpcUa_UInt32 transactionId,
             }
             i++;
         }
+        releaseItemVector(std::move(it->second.items));
         outstandingOps.erase(it);
     } else {
         if (debug)
@@ -700,7 +1120,20 @@ SessionUaSdk::readComplete (OpcUa_UInt32 transactionId,
                       << ": (readComplete) for read service"
                       << " (transaction id " << transactionId
                       << ") failed with status " << result.toString() << std::endl;
-        for (auto item : (*it->second)) {
+        if (isLimitError(result) && learnBatchLimit(reader, it->second.items->size(), name, "read")) {
+            // Re-queue (bisected through the lowered limit)
+            for (auto item : (*it->second.items)) {
+                const menuPriority priority = item->recConnector->getRecordPriority();
+                if (item->markReadQueued(priority))
+                    epics::atomic::increment(readsMerged);
+                else
+                    reader.pushRequest(item->readRequest(), priority);
+            }
+            releaseItemVector(std::move(it->second.items));
+            outstandingOps.erase(it);
+            return;
+        }
+        for (auto item : (*it->second.items)) {
             if (debug >= 5) {
                 std::cout << "** Session " << name.c_str()
                           << ": (readComplete) filing read error (no data) for item "
@@ -710,6 +1143,7 @@ SessionUaSdk::readComplete (OpcUa_UInt32 transactionId,
             // Not doing initial write if the read has failed
             item->setState(ConnectionStatus::up);
         }
+        releaseItemVector(std::move(it->second.items));
         outstandingOps.erase(it);
     }
 }
@@ -726,14 +1160,19 @@ SessionUaSdk::writeComplete (OpcUa_UInt32 transactionId,
         errlogPrintf("OPC UA session %s: (writeComplete) received a callback "
                      "with unknown transaction id %u - ignored\n",
                      name.c_str(), transactionId);
-    } else if (result.isGood()) {
+        return;
+    }
+    writer.reportLatency(epicsTime::getCurrent() - it->second.started, it->second.items->size());
+    writer.completeBatch(it->second.generation);
+    if (result.isGood()) {
+        writer.reportSuccess(it->second.items->size());
         if (debug >= 2)
             std::cout << "Session " << name.c_str()
                       << ": (writeComplete) getting results for write service"
                       << " (transaction id " << transactionId
                       << "; results for " << results.length() << " items)" << std::endl;
         OpcUa_UInt32 i = 0;
-        for (auto item : (*it->second)) {
+        for (auto item : (*it->second.items)) {
             if (debug >= 5) {
                 std::cout << "** Session " << name.c_str()
                           << ": (writeComplete) getting results for item "
@@ -746,6 +1185,7 @@ SessionUaSdk::writeComplete (OpcUa_UInt32 transactionId,
             item->setState(ConnectionStatus::up);
             i++;
         }
+        releaseItemVector(std::move(it->second.items));
         outstandingOps.erase(it);
     } else {
         if (debug)
@@ -753,7 +1193,10 @@ SessionUaSdk::writeComplete (OpcUa_UInt32 transactionId,
                       << ": (writeComplete) for write service"
                       << " (transaction id " << transactionId
                       << ") failed with status " << result.toString() << std::endl;
-        for (auto item : (*it->second)) {
+        // Payload is gone: learn the limit for the next batches, fail this one
+        if (isLimitError(result))
+            learnBatchLimit(writer, it->second.items->size(), name, "write");
+        for (auto item : (*it->second.items)) {
             if (debug >= 5) {
                 std::cout << "** Session " << name.c_str()
                           << ": (writeComplete) filing write error for item "
@@ -762,6 +1205,7 @@ SessionUaSdk::writeComplete (OpcUa_UInt32 transactionId,
             item->setIncomingEvent(ProcessReason::writeFailure);
             item->setState(ConnectionStatus::up);
         }
+        releaseItemVector(std::move(it->second.items));
         outstandingOps.erase(it);
     }
 }
@@ -783,6 +1227,10 @@ SessionUaSdk::showAll (const int level)
               << connected << " connected) with "
               << subscriptions << " subscription(s) and "
               << items << " items" << std::endl;
+    if (ClientQueueBudget::getLimit())
+        std::cout << "OPC UA: client queues using "
+                  << ClientQueueBudget::inUse() / 1000 << " of "
+                  << ClientQueueBudget::getLimit() / 1000 << " kB" << std::endl;
     if (level >= 1) {
         for (auto &it : sessions) {
             it.second->show(level-1);
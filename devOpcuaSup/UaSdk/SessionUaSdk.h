@@ -17,16 +17,22 @@
 #include <algorithm>
 #include <vector>
 #include <memory>
+#include <map>
+#include <string>
+#include <unordered_map>
 
 #include <uabase.h>
 #include <uaclientsdk.h>
 #include <uasession.h>
+#include <uastructuredefinition.h>
 
 #include <epicsMutex.h>
 #include <epicsTypes.h>
+#include <epicsTime.h>
 #include <initHooks.h>
 
 #include "RequestQueueBatcher.h"
+#include "TokenBucket.h"
 #include "Session.h"
 #include "Registry.h"
 
@@ -36,8 +42,60 @@ using namespace UaClientSdk;
 
 class SubscriptionUaSdk;
 class ItemUaSdk;
-struct WriteRequest;
-struct ReadRequest;
+
+/**
+ * @brief Cargo structure for write requests.
+ */
+struct WriteRequest {
+    ItemUaSdk *item;          /**< item to write */
+    OpcUa_WriteValue wvalue;  /**< value to write */
+    mutable size_t cost;      /**< cost accounted by the writer (0 = not yet) [bytes] */
+};
+
+/**
+ * @brief Cargo structure for read requests.
+ */
+struct ReadRequest {
+    ItemUaSdk *item;          /**< item to read */
+};
+
+/**
+ * @brief Data of an outstanding (read or write) service call.
+ */
+struct OutstandingOp {
+    OutstandingOp(std::unique_ptr<std::vector<ItemUaSdk *>> &&items, const unsigned int generation)
+        : items(std::move(items))
+        , started(epicsTime::getCurrent())
+        , generation(generation)
+    {}
+    std::unique_ptr<std::vector<ItemUaSdk *>> items;  /**< items of the request, in order */
+    epicsTime started;                                /**< time when the service was called */
+    unsigned int generation;                          /**< batcher generation of the request batch */
+};
+
+/**
+ * @brief A resolved structure definition, cached in the session.
+ *
+ * Shared (read-only) by all data elements of that structured type.
+ */
+struct StructureInfo {
+    StructureInfo(const UaStructureDefinition &definition)
+        : definition(definition)
+    {
+        for (int i = 0; i < definition.childrenCount(); i++)
+            childIndex.insert({definition.child(i).name().toUtf8(), i});
+    }
+    UaStructureDefinition definition;                  /**< structure definition from the dictionary */
+    std::unordered_map<std::string, int> childIndex;   /**< child name to field index map */
+};
+
+/**
+ * @brief Strict weak ordering of node ids (for use as map key).
+ */
+struct NodeIdLess {
+    bool operator()(const UaNodeId &a, const UaNodeId &b) const
+    { return OpcUa_NodeId_Compare(a, b) < 0; }
+};
 
 /**
  * @brief The SessionUaSdk implementation of an OPC UA client session.
@@ -118,6 +176,18 @@ public:
     UaStructureDefinition structureDefinition(const UaNodeId &dataTypeId)
     { return puasession->structureDefinition(dataTypeId); }
 
+    /**
+     * @brief Get a resolved structure definition from the session cache.
+     *
+     * The definition is taken from the session dictionary at the first request
+     * for a data type and kept until a new session is created.
+     * Failed lookups are not cached.
+     *
+     * @param dataTypeId data type (encoding id) of the extension object
+     * @return shared pointer to the structure info, nullptr if not available
+     */
+    std::shared_ptr<const StructureInfo> structureInfo(const UaNodeId &dataTypeId);
+
     /**
      * @brief Request a beginRead service for an item
      *
@@ -244,6 +314,8 @@ public:
     // RequestConsumer<> interfaces
     virtual void processRequests(std::vector<std::shared_ptr<WriteRequest>> &batch) override;
     virtual void processRequests(std::vector<std::shared_ptr<ReadRequest>> &batch) override;
+    virtual size_t requestCost(const WriteRequest &cargo) override;
+    virtual size_t requestCost(const ReadRequest &cargo) override;
 
 private:
     /**
@@ -261,6 +333,50 @@ private:
      */
     void updateNamespaceMap(const UaStringArray &nsArray);
 
+    /**
+     * @brief Handle a read batch that could not be sent.
+     *
+     * If the status signals that a server or encoding limit was exceeded,
+     * a lower batch size limit is learned and the requests are re-queued
+     * (so that they are sent in smaller batches). Otherwise (or if the batch
+     * only had a single request) read failure events are created for all items.
+     *
+     * @param batch  vector of read requests
+     * @param status  status of the failed service call
+     */
+    void retryOrFailReads(std::vector<std::shared_ptr<ReadRequest>> &batch, const UaStatus &status);
+
+    /**
+     * @brief Handle a write batch that could not be sent.
+     *
+     * If the status signals that a server or encoding limit was exceeded,
+     * a lower batch size limit is learned and the requests are re-queued
+     * (with the payload moved back from the request array). Otherwise (or if
+     * the batch only had a single request) write failure events are created for all items.
+     *
+     * @param batch  vector of write requests
+     * @param status  status of the failed service call
+     */
+    void retryOrFailWrites(std::vector<std::shared_ptr<WriteRequest>> &batch, const UaStatus &status);
+
+    /**
+     * @brief Get an (empty) vector for the items of a service call.
+     *
+     * Takes a vector from the spare pool if possible, allocates one otherwise.
+     *
+     * @param size  number of items to reserve space for
+     *
+     * @return unique_ptr to the item vector
+     */
+    std::unique_ptr<std::vector<ItemUaSdk *>> getItemVector(const size_t size);
+
+    /**
+     * @brief Return a vector for the items of a service call to the spare pool.
+     *
+     * @param v  unique_ptr to the item vector
+     */
+    void releaseItemVector(std::unique_ptr<std::vector<ItemUaSdk *>> &&v);
+
     static Registry<SessionUaSdk> sessions;                   /**< session management */
 
     const std::string name;                                   /**< unique session name */
@@ -276,18 +392,34 @@ private:
     SessionSecurityInfo securityInfo;                         /**< security metadata */
     UaClient::ServerStatus serverConnectionStatus;            /**< connection status for this session */
     int transactionId;                                        /**< next transaction id */
-    /** itemUaSdk vectors of outstanding read or write operations, indexed by transaction id */
-    std::map<OpcUa_UInt32, std::unique_ptr<std::vector<ItemUaSdk *>>> outstandingOps;
+    size_t readsMerged;                                       /**< number of read requests merged into queued ones */
+    /** outstanding read or write operations, indexed by transaction id */
+    std::map<OpcUa_UInt32, OutstandingOp> outstandingOps;
     epicsMutex opslock;                                       /**< lock for outstandingOps map */
-
+    static const size_t maxSpareItemVectors = 64;             /**< max size of the spare item vector pool */
+    std::vector<std::unique_ptr<std::vector<ItemUaSdk *>>> spareItemVectors; /**< spare item vectors (guarded by opslock) */
+    /** resolved structure definitions, indexed by data type id */
+    std::map<UaNodeId, std::shared_ptr<const StructureInfo>, NodeIdLess> structureCache;
+    epicsMutex structureLock;                                 /**< lock for structureCache map */
+    UaReadValueIds readValueIds;                              /**< read request array (reader thread only) */
+    UaWriteValues writeValues;                                /**< write request array (writer thread only) */
+
+    TokenBucket callLimiter;                                  /**< rate limiter for service calls (reader and writer) */
+    TokenBucket nodeLimiter;                                  /**< rate limiter for nodes (reader and writer) */
     RequestQueueBatcher<WriteRequest> writer;                 /**< batcher for write requests */
     unsigned int writeNodesMax;                               /**< max number of nodes per write request */
     unsigned int writeTimeoutMin;                             /**< timeout after write request batch of 1 node [ms] */
     unsigned int writeTimeoutMax;                             /**< timeout after write request of NodesMax nodes [ms] */
+    unsigned int writeLatencyTarget;                          /**< adaptive mode: write latency target [ms] */
+    bool writeCoalesce;                                       /**< flag: coalesce queued writes (last value wins) */
+    std::map<ItemUaSdk *, std::shared_ptr<WriteRequest>> queuedWrites; /**< queued writes (coalescing mode) */
+    size_t writesCoalesced;                                   /**< number of writes merged into queued ones */
+    epicsMutex writelock;                                     /**< lock for queuedWrites map and write cargo */
     RequestQueueBatcher<ReadRequest> reader;                  /**< batcher for read requests */
     unsigned int readNodesMax;                                /**< max number of nodes per read request */
     unsigned int readTimeoutMin;                              /**< timeout after read request batch of 1 node [ms] */
     unsigned int readTimeoutMax;                              /**< timeout after read request batch of NodesMax nodes [ms] */
+    unsigned int readLatencyTarget;                           /**< adaptive mode: read latency target [ms] */
 };
 
 } // namespace DevOpcua
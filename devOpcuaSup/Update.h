@@ -12,6 +12,7 @@
 #define DEVOPCUA_UPDATE_H
 
 #include <memory>
+#include <type_traits>
 #include <utility>
 #include <queue>
 
@@ -33,11 +34,14 @@ namespace DevOpcua {
  * - update type (ProcessReason for the update)
  *
  * and the optional (implementation dependent type) parts
- * - data object (using a std::unique_ptr)
+ * - data object
  * - status code
  *
- * Update uses C++11 std::unique_ptr to manage the data object, i.e.
- * the data is owned by the Update until it goes out of scope.
+ * The data object is stored in place (inside the Update), so that creating
+ * an update does not need a separate heap allocation for its data.
+ * Together with a pooled allocator for the Update itself (see UpdatePool.h),
+ * this keeps the path for incoming data free of heap allocations.
+ * The data type T must be default constructible.
  * The status code is assumed to be small, i.e. the minimal raw type
  * that holds an OPC UA status.
  */
@@ -49,8 +53,7 @@ public:
     /**
      * @brief Constructor with const reference for data.
      *
-     * This constructor creates a new unique_ptr managed data object,
-     * creating a copy of the data.
+     * This constructor creates a copy of the data inside the update.
      *
      * @param time  EPICS time stamp of this update
      * @param type  type of the update (process reason)
@@ -62,14 +65,39 @@ public:
         : overrides(0)
         , ts(time)
         , type(reason)
-        , data(std::unique_ptr<T>(new T(newdata)))
+        , data(newdata)
+        , hasData(true)
+        , status(status)
+    {}
+
+    /**
+     * @brief Constructor creating the data from a different type.
+     *
+     * This constructor creates the data inside the update directly from
+     * the source object (using a converting constructor of the data type),
+     * avoiding a temporary copy.
+     *
+     * @param time  EPICS time stamp of this update
+     * @param type  type of the update (process reason)
+     * @param source  const reference to the source of the data
+     * @param status  status code related to the update
+     */
+    template<typename D,
+             typename = typename std::enable_if<std::is_constructible<T, const D &>::value>::type>
+    Update(const epicsTime &time, ProcessReason reason,
+           const D &source, S status)
+        : overrides(0)
+        , ts(time)
+        , type(reason)
+        , data(source)
+        , hasData(true)
         , status(status)
     {}
 
     /**
      * @brief Constructor with unique_ptr for data.
      *
-     * This constructor moves a unique_ptr managed data rvalue
+     * This constructor moves the unique_ptr managed data
      * into the Update.
      *
      * @param ts  EPICS time stamp of this update
@@ -82,9 +110,13 @@ public:
         : overrides(0)
         , ts(time)
         , type(reason)
-        , data(std::move(newdata))
+        , data()
+        , hasData(bool(newdata))
         , status(status)
-    {}
+    {
+        if (newdata)
+            data = std::move(*newdata);
+    }
 
     /**
      * @brief Constructor with no data, for service
@@ -98,6 +130,8 @@ public:
         : overrides(0)
         , ts(time)
         , type(reason)
+        , data()
+        , hasData(false)
         , status()
     {}
 
@@ -118,7 +152,10 @@ public:
         ts = other.getTimeStamp();
         type = other.getType();
         overrides += other.getOverrides() + 1;
-        data = other.releaseData();
+        hasData = other.hasData;
+        if (hasData)
+            data = std::move(other.data);
+        other.hasData = false;
         status = other.getStatus();
     }
 
@@ -155,10 +192,18 @@ public:
      * @brief Mover for the update's data.
      *
      * Ownership is moved from update to the caller.
+     * As the data is stored in place, this creates a new heap object;
+     * use getData() on paths that should not allocate.
      *
-     * @return  unique_ptr to the update data
+     * @return  unique_ptr to the update data (empty if the update has no data)
      */
-    std::unique_ptr<T> releaseData() { return std::move(data); }
+    std::unique_ptr<T> releaseData()
+    {
+        if (!hasData)
+            return std::unique_ptr<T>();
+        hasData = false;
+        return std::unique_ptr<T>(new T(std::move(data)));
+    }
 
     /**
      * @brief Getter for the update's data.
@@ -168,7 +213,8 @@ public:
      *
      * @return  reference to the update's data
      */
-    T& getData() const { return *data; }
+    T& getData() { return data; }
+    const T& getData() const { return data; }
 
     /**
      * @brief Getter for the update's status.
@@ -189,16 +235,17 @@ public:
     /**
      * @brief Checks if the update contains data.
      *
-     * Checks if this->data stores a pointer, i.e. whether getData() is
+     * Checks if the update holds data, i.e. whether getData() is
      * defined.
      */
-    explicit operator bool() const noexcept { return bool(data); }
+    explicit operator bool() const noexcept { return hasData; }
 
 private:
     unsigned long overrides;
     epicsTime ts;
     ProcessReason type;
-    std::unique_ptr<T> data;
+    T data;
+    bool hasData;
     S status;
 };
 
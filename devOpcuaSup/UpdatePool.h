@@ -0,0 +1,157 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#ifndef DEVOPCUA_UPDATEPOOL_H
+#define DEVOPCUA_UPDATEPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#include "SparePool.h"
+
+namespace DevOpcua {
+
+/**
+ * @class BlockPool
+ * @brief A thread safe pool of fixed size memory blocks.
+ *
+ * Keeps up to a fixed number of spare blocks in a bounded lock-free pool
+ * (SparePool), so that blocks freed by one thread
+ * (e.g. record processing) can be reused by another (e.g. the client library
+ * pushing incoming data) without going through the heap.
+ * Blocks are only allocated when the pool is empty, and only freed when it is full.
+ *
+ * The block size is set by the first allocation. Larger requests are served
+ * from the heap directly.
+ *
+ * The pool must outlive all blocks that were allocated from it.
+ */
+class BlockPool
+{
+public:
+    /**
+     * @brief Construct a pool.
+     *
+     * @param spareBlocks  capacity of the pool (rounded up to a power of 2, at least 2)
+     */
+    explicit BlockPool(const size_t spareBlocks = 16)
+        : size(0)
+        , pool(spareBlocks)
+        , heapAllocs(0)
+    {}
+
+    ~BlockPool()
+    {
+        while (void *p = pool.get())
+            ::operator delete(p);
+    }
+
+    BlockPool(const BlockPool &) = delete;
+    BlockPool &operator=(const BlockPool &) = delete;
+
+    /**
+     * @brief Allocates a block (thread safe).
+     *
+     * @param bytes  required size
+     *
+     * @return  pointer to the block
+     */
+    void *allocate(const size_t bytes)
+    {
+        size_t bs = blockSize();
+        if (!bs) {
+            size_t expected = 0;
+            size.compare_exchange_strong(expected, bytes);
+            bs = blockSize();
+        }
+        if (bytes <= bs) {
+            if (void *p = pool.get())
+                return p;
+        } else {
+            bs = bytes;
+        }
+        heapAllocs.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(bs);
+    }
+
+    /**
+     * @brief Returns a block to the pool (thread safe).
+     *
+     * @param p  pointer to the block
+     * @param bytes  size that was used to allocate the block
+     */
+    void deallocate(void *p, const size_t bytes) noexcept
+    {
+        if (bytes > blockSize() || !pool.put(p))
+            ::operator delete(p);
+    }
+
+    /**
+     * @brief Returns the block size (0 = not set yet).
+     * @return  block size
+     */
+    size_t blockSize() const { return size.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Returns the number of spare blocks in the pool (approximate).
+     * @return  number of spare blocks
+     */
+    size_t spareBlocks() const { return pool.size(); }
+
+    /**
+     * @brief Returns the number of allocations that went to the heap.
+     * @return  number of heap allocations
+     */
+    unsigned long noOfHeapAllocations() const { return heapAllocs.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<size_t> size;            /**< block size (set by first allocation) */
+    SparePool<void *> pool;              /**< spare block pool */
+    std::atomic<unsigned long> heapAllocs; /**< statistics: heap allocations */
+};
+
+/**
+ * @class PoolAllocator
+ * @brief Standard allocator that takes its memory from a BlockPool.
+ *
+ * Meant for std::allocate_shared, which allocates the object and the
+ * shared_ptr control block as one block of memory:
+ * @code
+ *     auto u = std::allocate_shared<UpdateUaSdk>(PoolAllocator<UpdateUaSdk>(pool), ...);
+ * @endcode
+ */
+template<typename T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit PoolAllocator(BlockPool &pool) noexcept : pool(&pool) {}
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U> &other) noexcept : pool(other.pool) {}
+
+    T *allocate(const size_t n) { return static_cast<T *>(pool->allocate(n * sizeof(T))); }
+    void deallocate(T *p, const size_t n) noexcept { pool->deallocate(p, n * sizeof(T)); }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U> &other) const noexcept { return pool == other.pool; }
+    template<typename U>
+    bool operator!=(const PoolAllocator<U> &other) const noexcept { return pool != other.pool; }
+
+private:
+    template<typename U> friend class PoolAllocator;
+    BlockPool *pool;
+};
+
+} // namespace DevOpcua
+
+#endif // DEVOPCUA_UPDATEPOOL_H
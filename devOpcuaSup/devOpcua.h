@@ -84,11 +84,15 @@ typedef struct linkInfo {
     double samplingInterval;
     epicsUInt32 queueSize;
     epicsUInt32 clientQueueSize;
+    epicsUInt32 minClientQueueSize = 0;
+    epicsUInt32 maxClientQueueSize = 0; /**< 0 = fixed client queue size */
     bool discardOldest = true;
 
     std::string element;
     std::list<std::string> elementPath;
     bool useServerTimestamp = true;
+    bool drainQueue = false;
+    double maxAge = 0.0;
     LinkOptionBini bini = LinkOptionBini::read;
 
     bool isOutput;
@@ -14,10 +14,12 @@
 #include <string>
 #include <string.h>
 #include <stdexcept>
+#include <algorithm>
 
 #include <iocsh.h>
 #include <errlog.h>
 #include <epicsThread.h>
+#include <initHooks.h>
 
 #include <epicsExport.h>  // defines epicsExportSharedSymbols
 #include "iocshVariables.h"
@@ -26,6 +28,7 @@
 #include "Subscription.h"
 #include "Registry.h"
 #include "RecordConnector.h"
+#include "RingUpdateQueue.h"
 
 namespace DevOpcua {
 
@@ -46,6 +49,8 @@ int opcua_DefaultUseServerTime = 1;              // use server timestamp
 int opcua_DefaultOutputReadback = 1;             // make outputs bidirectional
 double opcua_ClientQueueSizeFactor = 1.5;        // client queue size factor (* server side size)
 int opcua_MinimumClientQueueSize = 3;            // minimum client queue size
+int opcua_MaximumClientQueueSize = 0;            // fixed client queue size (no adaptive sizing)
+double opcua_ClientQueueMemoryLimit = 0.0;       // no memory limit for adaptive client queues [MB]
 
 extern "C" {
 epicsExportAddress(double, opcua_ConnectTimeout);
@@ -58,6 +63,8 @@ epicsExportAddress(int, opcua_DefaultUseServerTime);
 epicsExportAddress(int, opcua_DefaultOutputReadback);
 epicsExportAddress(double, opcua_ClientQueueSizeFactor);
 epicsExportAddress(int, opcua_MinimumClientQueueSize);
+epicsExportAddress(int, opcua_MaximumClientQueueSize);
+epicsExportAddress(double, opcua_ClientQueueMemoryLimit);
 }
 
 } // namespace DevOpcua
@@ -491,9 +498,19 @@ void opcuaShowDataCallFunc (const iocshArgBuf *args)
     }
 }
 
+// Apply the configuration variables that are not used during link parsing
+static
+void opcuaInitHook (initHookState state)
+{
+    if (state == initHookAtIocBuild)
+        ClientQueueBudget::setLimit(static_cast<size_t>(std::max(0.0, opcua_ClientQueueMemoryLimit) * 1e6));
+}
+
 static
 void opcuaIocshRegister ()
 {
+    (void) initHookRegister(opcuaInitHook);
+
     iocshRegister(&opcuaCreateSessionFuncDef, opcuaCreateSessionCallFunc);
     iocshRegister(&opcuaSetOptionFuncDef, opcuaSetOptionCallFunc);
     iocshRegister(&opcuaMapNamespaceFuncDef, opcuaMapNamespaceCallFunc);
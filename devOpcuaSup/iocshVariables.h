@@ -39,6 +39,8 @@ extern int opcua_DefaultUseServerTime;         /**< timestamp selection (1 = use
 extern int opcua_DefaultOutputReadback;        /**< output record handling (1 = bidirectional) */
 extern double opcua_ClientQueueSizeFactor;     /**< client queue size factor (* server side size) */
 extern int opcua_MinimumClientQueueSize;       /**< minimum client queue size */
+extern int opcua_MaximumClientQueueSize;       /**< maximum client queue size (0 = fixed size, > 0 = adaptive) */
+extern double opcua_ClientQueueMemoryLimit;    /**< memory budget for all adaptive client queues [MB] (0 = no limit) */
 
 } // namespace DevOpcua
 
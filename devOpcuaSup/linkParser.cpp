@@ -45,6 +45,42 @@ getYesNo (const char c)
         throw std::runtime_error(SB() << "illegal value '" << c << "'");
 }
 
+bool
+getYesNoOption (const std::string &optname, const std::string &optval)
+{
+    if (optval.length() == 0)
+        throw std::runtime_error(SB() << "no value for option '" << optname << "'");
+    return getYesNo(optval[0]);
+}
+
+double
+getMaxAge (const std::string &value)
+{
+    double age;
+    if (epicsParseDouble(value.c_str(), &age, nullptr))
+        throw std::runtime_error(SB() << "error converting '" << value << "' to Double");
+    if (!(age >= 0.0)) // also catches NaN
+        throw std::runtime_error(SB() << "illegal value '" << value << "' (must be >= 0)");
+    return age;
+}
+
+void
+setClientQueueSize (linkInfo &info)
+{
+    if (info.clientQueueSize)
+        return;
+    info.clientQueueSize = static_cast<epicsUInt32>(ceil(abs(opcua_ClientQueueSizeFactor) * info.queueSize));
+    epicsUInt32 mini = static_cast<epicsUInt32>(abs(opcua_MinimumClientQueueSize));
+    if (info.clientQueueSize < mini) info.clientQueueSize = mini;
+    // adaptive sizing (only for computed sizes)
+    epicsUInt32 maxi = static_cast<epicsUInt32>(abs(opcua_MaximumClientQueueSize));
+    if (maxi && info.clientQueueSize > 1) {
+        // never shrink into a conflating slot (size 1)
+        info.minClientQueueSize = std::max(mini, 2u);
+        info.maxClientQueueSize = std::max(maxi, info.clientQueueSize);
+    }
+}
+
 std::list<std::string>
 splitString(const std::string &str, const char delim)
 {
@@ -141,6 +177,18 @@ parseLink (dbCommon *prec, const DBEntry &ent)
     else
         pinfo->monitor = getYesNo(s[0]);
 
+    s = ent.info("opcua:DRAIN", "");
+    if (debug > 19 && s[0] != '\0')
+        std::cerr << prec->name << " info 'opcua:DRAIN'='" << s << "'" << std::endl;
+    if (s[0] != '\0')
+        pinfo->drainQueue = getYesNo(s[0]);
+
+    s = ent.info("opcua:MAXAGE", "");
+    if (debug > 19 && s[0] != '\0')
+        std::cerr << prec->name << " info 'opcua:MAXAGE'='" << s << "'" << std::endl;
+    if (s[0] != '\0')
+        pinfo->maxAge = getMaxAge(s);
+
     s = ent.info("opcua:ELEMENT", "");
     if (debug > 19 && s[0] != '\0')
         std::cerr << prec->name << " info 'opcua:ELEMENT'='" << s << "'" << std::endl;
@@ -266,6 +314,10 @@ parseLink (dbCommon *prec, const DBEntry &ent)
             } else {
                 throw std::runtime_error(SB() << "no value for option '" << optname << "'");
             }
+        } else if (optname == "drain") {
+            pinfo->drainQueue = getYesNoOption(optname, optval);
+        } else if (optname == "maxage") {
+            pinfo->maxAge = getMaxAge(optval);
         } else if (optname == "element") {
             pinfo->element = optval;
             pinfo->elementPath = splitString(optval);
@@ -285,11 +337,7 @@ parseLink (dbCommon *prec, const DBEntry &ent)
         sep = linkstr.find_first_not_of("; \t", send);
     }
 
-    if (!pinfo->clientQueueSize) {
-        pinfo->clientQueueSize = static_cast<epicsUInt32>(ceil(abs(opcua_ClientQueueSizeFactor) * pinfo->queueSize));
-        epicsUInt32 mini = static_cast<epicsUInt32>(abs(opcua_MinimumClientQueueSize));
-        if (pinfo->clientQueueSize < mini) pinfo->clientQueueSize = mini;
-    }
+    setClientQueueSize(*pinfo);
 
     if (debug > 4) {
         std::cout << prec->name << " :";
@@ -305,8 +353,10 @@ parseLink (dbCommon *prec, const DBEntry &ent)
                 std::cout << " id(s)=" << pinfo->identifierString;
             std::cout << " sampling=" << pinfo->samplingInterval
                       << " qsize=" << pinfo->queueSize
-                      << " cqsize=" << pinfo->clientQueueSize
-                      << " discard=" << (pinfo->discardOldest ? "old" : "new")
+                      << " cqsize=" << pinfo->clientQueueSize;
+            if (pinfo->maxClientQueueSize)
+                std::cout << "(" << pinfo->minClientQueueSize << "-" << pinfo->maxClientQueueSize << ")";
+            std::cout << " discard=" << (pinfo->discardOldest ? "old" : "new")
                       << " registered=" << (pinfo->registerNode ? "y" : "n");
         } else {
             std::cout << " element=" << pinfo->element;
@@ -314,6 +364,8 @@ parseLink (dbCommon *prec, const DBEntry &ent)
         std::cout << " timestamp=" << (pinfo->useServerTimestamp ? "server" : "source")
                   << " output=" << (pinfo->isOutput ? "y" : "n")
                   << " monitor=" << (pinfo->monitor ? "y" : "n")
+                  << " drain=" << (pinfo->drainQueue ? "y" : "n")
+                  << " maxage=" << pinfo->maxAge
                   << " bini=" << linkOptionBiniString(pinfo->bini)
                   << std::endl;
     }
@@ -26,6 +26,29 @@ static const char defaultElementDelimiter = '.';
 
 bool getYesNo(const char c);
 
+/**
+ * @brief Get the boolean value of a yes/no link option.
+ *
+ * @param optname  option name (for the error message)
+ * @param optval  option value
+ *
+ * @return  `true` for yes, `false` for no
+ *
+ * @throws std::runtime_error if the value is missing or illegal
+ */
+bool getYesNoOption(const std::string &optname, const std::string &optval);
+
+/**
+ * @brief Get the value of a maximum age (opcua:MAXAGE info item or maxage= option).
+ *
+ * @param value  string to convert
+ *
+ * @return  maximum age [s], 0 = no limit
+ *
+ * @throws std::runtime_error if the value is not a number or negative
+ */
+double getMaxAge(const std::string &value);
+
 /**
  * @brief Split configuration string along delimiters into a list<string>.
  *
@@ -37,6 +60,18 @@ bool getYesNo(const char c);
  *
  * @return  tokens in order of appearance as list<string>
  */
+/**
+ * @brief Compute the client queue size (if not set explicitly by the cqsize option).
+ *
+ * The size is computed from the server side queue size and the configuration
+ * variables opcua_ClientQueueSizeFactor and opcua_MinimumClientQueueSize.
+ * If opcua_MaximumClientQueueSize is set, a computed size is made adaptive,
+ * with a floor of opcua_MinimumClientQueueSize (at least 2).
+ *
+ * @param info  link info to update
+ */
+void setClientQueueSize(linkInfo &info);
+
 std::list<std::string> splitString(const std::string &str,
                                    const char delim = defaultElementDelimiter);
 
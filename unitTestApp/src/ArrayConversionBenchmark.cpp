@@ -0,0 +1,117 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <cstdint>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <gtest/gtest.h>
+
+#include "ArrayConversion.h"
+
+// Throughput benchmark for the element-wise conversion of array reads (saturating)
+// and writes (range checked) with mismatched types, for arrays of 1k to 1M elements.
+// The same-type copy (memcpy) is shown as reference.
+// Not run as part of the regular test suite - results are printed on stdout.
+
+namespace {
+
+using namespace DevOpcua;
+
+const size_t arraySizes[] = { 1000, 10000, 100000, 1000000 };
+const size_t elementsPerRun = 100000000;
+
+template<typename TO, typename FROM>
+bool
+convert(TO *to, const FROM *from, const size_t n, const bool checked)
+{
+    if (checked)
+        return convertArrayChecked(to, from, n) != n;
+    else
+        return convertArray(to, from, n);
+}
+
+// Converts arrays of size n repeatedly (about elementsPerRun elements in total)
+// Returns the throughput [Melements/s]
+template<typename TO, typename FROM>
+double
+runConversion(const size_t n, const bool checked)
+{
+    std::vector<FROM> from(n);
+    std::vector<TO> to(n);
+    for (size_t i = 0; i < n; i++)
+        from[i] = static_cast<FROM>(i % 100);
+    size_t rounds = elementsPerRun / n;
+    bool clipped = false;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        clipped |= convert(to.data(), from.data(), n, checked);
+        from[r % n] = static_cast<FROM>(to[(r + 1) % n]); // keep the compiler from hoisting the loop
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_FALSE(clipped) << "elements out of range reported for values in range";
+    return rounds * n / elapsed.count() / 1e6;
+}
+
+template<typename TO, typename FROM>
+void
+printRow(const std::string &pair, const bool checked = false)
+{
+    std::cout << std::setw(18) << pair;
+    for (auto n : arraySizes)
+        std::cout << std::setw(12) << std::fixed << std::setprecision(0) << runConversion<TO, FROM>(n, checked);
+    std::cout << std::endl;
+}
+
+void
+printHeader(const std::string &title)
+{
+    std::cout << std::setw(18) << title;
+    for (auto n : arraySizes)
+        std::cout << std::setw(12) << n;
+    std::cout << std::endl;
+}
+
+TEST(ArrayConversionBenchmark, convertArray_1kTo1M) {
+    printHeader("read [Melem/s]");
+
+    printRow<double, double>("Double<-Double");
+    printRow<double, int16_t>("Double<-Int16");
+    printRow<double, int32_t>("Double<-Int32");
+    printRow<double, float>("Double<-Float");
+    printRow<float, double>("Float<-Double");
+    printRow<int16_t, int32_t>("Int16<-Int32");
+    printRow<uint8_t, int16_t>("UInt8<-Int16");
+    printRow<int32_t, uint32_t>("Int32<-UInt32");
+    printRow<int32_t, double>("Int32<-Double");
+    printRow<int16_t, float>("Int16<-Float");
+    printRow<double, uint64_t>("Double<-UInt64");
+    printRow<int32_t, int64_t>("Int32<-Int64");
+}
+
+TEST(ArrayConversionBenchmark, convertArrayChecked_1kTo1M) {
+    printHeader("write [Melem/s]");
+
+    printRow<double, double>("Double<-Double", true);
+    printRow<int64_t, int32_t>("Int64<-Int32", true);
+    printRow<float, double>("Float<-Double", true);
+    printRow<int16_t, double>("Int16<-Double", true);
+    printRow<int32_t, double>("Int32<-Double", true);
+    printRow<int16_t, int32_t>("Int16<-Int32", true);
+    printRow<uint32_t, int32_t>("UInt32<-Int32", true);
+    printRow<uint8_t, int32_t>("UInt8<-Int32", true);
+    printRow<int32_t, int64_t>("Int32<-Int64", true);
+}
+
+} // namespace
@@ -0,0 +1,134 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "ArrayConversion.h"
+
+namespace {
+
+using namespace DevOpcua;
+
+template<typename TO, typename FROM>
+bool
+convert (const std::vector<FROM> &from, std::vector<TO> &to)
+{
+    to.assign(from.size(), TO(0));
+    return convertArray(to.data(), from.data(), from.size());
+}
+
+TEST(ArrayConversionTest, sameType_Copied) {
+    std::vector<int16_t> from = { -3, 0, 32767 }, to;
+    EXPECT_FALSE(convert(from, to)) << "copy reports elements out of range";
+    EXPECT_EQ(to, from) << "copy differs from source";
+}
+
+TEST(ArrayConversionTest, widening_ExactValues) {
+    std::vector<int16_t> i16 = { -32768, -1, 0, 1, 32767 };
+    std::vector<double> d;
+    std::vector<int64_t> i64;
+    EXPECT_FALSE(convert(i16, d)) << "Double<-Int16 reports elements out of range";
+    EXPECT_FALSE(convert(i16, i64)) << "Int64<-Int16 reports elements out of range";
+    for (size_t i = 0; i < i16.size(); i++) {
+        EXPECT_EQ(d[i], i16[i]) << "Double<-Int16 wrong value at " << i;
+        EXPECT_EQ(i64[i], i16[i]) << "Int64<-Int16 wrong value at " << i;
+    }
+
+    std::vector<float> f = { -1.5f, 3.25f, std::numeric_limits<float>::infinity() };
+    EXPECT_FALSE(convert(f, d)) << "Double<-Float reports elements out of range";
+    EXPECT_EQ(d[1], 3.25) << "Double<-Float wrong value";
+    EXPECT_TRUE(std::isinf(d[2])) << "Double<-Float infinity not kept";
+}
+
+TEST(ArrayConversionTest, integerNarrowing_Saturates) {
+    std::vector<int32_t> i32 = { -100000, -129, -128, 0, 127, 128, 100000 };
+    std::vector<int8_t> i8;
+    std::vector<uint8_t> u8;
+    EXPECT_TRUE(convert(i32, i8)) << "Int8<-Int32 does not report elements out of range";
+    EXPECT_EQ(i8, (std::vector<int8_t>{ -128, -128, -128, 0, 127, 127, 127 })) << "Int8<-Int32 not saturated";
+    EXPECT_TRUE(convert(i32, u8)) << "UInt8<-Int32 does not report elements out of range";
+    EXPECT_EQ(u8, (std::vector<uint8_t>{ 0, 0, 0, 0, 127, 128, 255 })) << "UInt8<-Int32 not saturated";
+
+    std::vector<int32_t> small = { -128, 5, 127 };
+    EXPECT_FALSE(convert(small, i8)) << "Int8<-Int32 reports elements in range as out of range";
+    EXPECT_EQ(i8, (std::vector<int8_t>{ -128, 5, 127 })) << "Int8<-Int32 wrong values";
+}
+
+TEST(ArrayConversionTest, signedness_Saturates) {
+    std::vector<uint32_t> u32 = { 0, 0x7fffffffu, 0x80000000u, 0xffffffffu };
+    std::vector<int32_t> i32;
+    EXPECT_TRUE(convert(u32, i32)) << "Int32<-UInt32 does not report elements out of range";
+    EXPECT_EQ(i32[3], std::numeric_limits<int32_t>::max()) << "Int32<-UInt32 not saturated";
+
+    std::vector<int64_t> i64 = { std::numeric_limits<int64_t>::min(), -1, 5 };
+    std::vector<uint64_t> u64;
+    EXPECT_TRUE(convert(i64, u64)) << "UInt64<-Int64 does not report elements out of range";
+    EXPECT_EQ(u64, (std::vector<uint64_t>{ 0, 0, 5 })) << "UInt64<-Int64 not saturated";
+}
+
+TEST(ArrayConversionTest, floatToInteger_SaturatesAndHandlesNaN) {
+    std::vector<double> d = { -1e300, -32768.5, -2.7, 2.7, 32767.9, 32768.0,
+                              std::numeric_limits<double>::quiet_NaN(),
+                              std::numeric_limits<double>::infinity() };
+    std::vector<int16_t> i16;
+    EXPECT_TRUE(convert(d, i16)) << "Int16<-Double does not report elements out of range";
+    EXPECT_EQ(i16, (std::vector<int16_t>{ -32768, -32768, -2, 2, 32767, 32767, 0, 32767 }))
+            << "Int16<-Double not saturated";
+
+    std::vector<double> big = { 9.3e18, 1.9e19, -1.0 };
+    std::vector<int64_t> i64;
+    std::vector<uint64_t> u64;
+    EXPECT_TRUE(convert(big, i64)) << "Int64<-Double does not report elements out of range";
+    EXPECT_EQ(i64[0], std::numeric_limits<int64_t>::max()) << "Int64<-Double not saturated";
+    EXPECT_TRUE(convert(big, u64)) << "UInt64<-Double does not report elements out of range";
+    EXPECT_EQ(u64[0], 9300000000000000000ull) << "UInt64<-Double wrong value";
+    EXPECT_EQ(u64[1], std::numeric_limits<uint64_t>::max()) << "UInt64<-Double not saturated";
+    EXPECT_EQ(u64[2], 0u) << "UInt64<-Double negative value not saturated";
+}
+
+TEST(ArrayConversionTest, doubleToFloat_SaturatesFiniteValues) {
+    std::vector<double> d = { 1e300, -1e300, 0.5,
+                              -std::numeric_limits<double>::infinity(),
+                              std::numeric_limits<double>::quiet_NaN() };
+    std::vector<float> f;
+    EXPECT_TRUE(convert(d, f)) << "Float<-Double does not report elements out of range";
+    EXPECT_EQ(f[0], std::numeric_limits<float>::max()) << "Float<-Double not saturated";
+    EXPECT_EQ(f[1], std::numeric_limits<float>::lowest()) << "Float<-Double not saturated";
+    EXPECT_EQ(f[2], 0.5f) << "Float<-Double wrong value";
+    EXPECT_TRUE(std::isinf(f[3]) && f[3] < 0) << "Float<-Double infinity not kept";
+    EXPECT_TRUE(std::isnan(f[4])) << "Float<-Double NaN not kept";
+}
+
+TEST(ArrayConversionTest, checked_ReportsFirstOutOfRangeIndex) {
+    std::vector<int32_t> from(3000, 1);
+    std::vector<int16_t> to(from.size());
+    EXPECT_EQ(convertArrayChecked(to.data(), from.data(), from.size()), from.size())
+            << "Int16<-Int32 elements in range reported as out of range";
+    EXPECT_EQ(to[2999], 1) << "Int16<-Int32 wrong value";
+
+    from[2500] = -40000;
+    from[2700] = 40000;
+    EXPECT_EQ(convertArrayChecked(to.data(), from.data(), from.size()), 2500u)
+            << "Int16<-Int32 wrong index of first element out of range";
+    from[5] = 32768;
+    EXPECT_EQ(convertArrayChecked(to.data(), from.data(), from.size()), 5u)
+            << "Int16<-Int32 wrong index of first element out of range";
+
+    std::vector<double> d = { 0.0, 1.0, std::numeric_limits<double>::quiet_NaN() };
+    std::vector<int32_t> i32(d.size());
+    EXPECT_EQ(convertArrayChecked(i32.data(), d.data(), d.size()), 2u) << "Int32<-Double NaN not out of range";
+}
+
+} // namespace
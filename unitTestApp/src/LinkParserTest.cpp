@@ -9,11 +9,14 @@
  */
 
 #include <list>
+#include <string>
+#include <stdexcept>
 #include <gtest/gtest.h>
 
 #include <epicsTime.h>
 
 #include "linkParser.h"
+#include "iocshVariables.h"
 
 namespace {
 
@@ -172,4 +175,134 @@ TEST(LinkParserTest, splitString_endsWithTwoDelimiters) {
     EXPECT_EQ(*it++, "") << "path[2] not empty after splitting '" << s << "'";
 }
 
+/* bool getYesNoOption(const std::string &optname, const std::string &optval);
+ *
+ * @brief Get the boolean value of a yes/no link option (e.g. drain=).
+ */
+
+TEST(LinkParserTest, drain_yesValues) {
+    for (const std::string v : { "y", "yes", "Y", "t", "true", "1" })
+        EXPECT_TRUE(getYesNoOption("drain", v)) << "drain=" << v << " not parsed as yes";
+}
+
+TEST(LinkParserTest, drain_noValues) {
+    for (const std::string v : { "n", "no", "N", "f", "false", "0" })
+        EXPECT_FALSE(getYesNoOption("drain", v)) << "drain=" << v << " not parsed as no";
+}
+
+TEST(LinkParserTest, drain_missingValueThrows) {
+    EXPECT_THROW(getYesNoOption("drain", ""), std::runtime_error) << "drain= without value accepted";
+}
+
+TEST(LinkParserTest, drain_illegalValueThrows) {
+    EXPECT_THROW(getYesNoOption("drain", "maybe"), std::runtime_error) << "drain=maybe accepted";
+}
+
+TEST(LinkParserTest, drain_linkOptionOverridesInfo) {
+    linkInfo info;
+    EXPECT_FALSE(info.drainQueue) << "drain enabled by default";
+    // info item opcua:DRAIN sets the default, the link option overrides it
+    info.drainQueue = getYesNo('y');
+    info.drainQueue = getYesNoOption("drain", "n");
+    EXPECT_FALSE(info.drainQueue) << "link option drain=n did not override info item";
+    info.drainQueue = getYesNo('n');
+    info.drainQueue = getYesNoOption("drain", "y");
+    EXPECT_TRUE(info.drainQueue) << "link option drain=y did not override info item";
+}
+
+/* double getMaxAge(const std::string &value);
+ *
+ * @brief Get the value of a maximum age (opcua:MAXAGE info item or maxage= option).
+ */
+
+TEST(LinkParserTest, maxAge_validValues) {
+    EXPECT_DOUBLE_EQ(getMaxAge("0"), 0.0) << "maxage=0 not parsed correctly";
+    EXPECT_DOUBLE_EQ(getMaxAge("2.5"), 2.5) << "maxage=2.5 not parsed correctly";
+    EXPECT_DOUBLE_EQ(getMaxAge("1e-3"), 0.001) << "maxage=1e-3 not parsed correctly";
+}
+
+TEST(LinkParserTest, maxAge_invalidStringThrows) {
+    EXPECT_THROW(getMaxAge("old"), std::runtime_error) << "maxage=old accepted";
+    EXPECT_THROW(getMaxAge(""), std::runtime_error) << "maxage= without value accepted";
+}
+
+TEST(LinkParserTest, maxAge_negativeOrNaNThrows) {
+    EXPECT_THROW(getMaxAge("-1"), std::runtime_error) << "maxage=-1 accepted";
+    EXPECT_THROW(getMaxAge("-0.1"), std::runtime_error) << "maxage=-0.1 accepted";
+    EXPECT_THROW(getMaxAge("nan"), std::runtime_error) << "maxage=nan accepted";
+}
+
+/* void setClientQueueSize(linkInfo &info);
+ *
+ * @brief Compute the client queue size (if not set explicitly by the cqsize option).
+ */
+
+// Sets the client queue size variables, restores them when going out of scope
+class ClientQueueVariables {
+public:
+    ClientQueueVariables(const double factor, const int mini, const int maxi)
+        : factor(opcua_ClientQueueSizeFactor)
+        , mini(opcua_MinimumClientQueueSize)
+        , maxi(opcua_MaximumClientQueueSize)
+    {
+        opcua_ClientQueueSizeFactor = factor;
+        opcua_MinimumClientQueueSize = mini;
+        opcua_MaximumClientQueueSize = maxi;
+    }
+    ~ClientQueueVariables()
+    {
+        opcua_ClientQueueSizeFactor = factor;
+        opcua_MinimumClientQueueSize = mini;
+        opcua_MaximumClientQueueSize = maxi;
+    }
+private:
+    double factor;
+    int mini;
+    int maxi;
+};
+
+TEST(LinkParserTest, clientQueueSize_fixedWithoutMaximum) {
+    ClientQueueVariables vars(1.5, 3, 0);
+    linkInfo info;
+    info.queueSize = 10;
+    info.clientQueueSize = 0;
+    setClientQueueSize(info);
+    EXPECT_EQ(info.clientQueueSize, 15u) << "computed client queue size wrong";
+    EXPECT_EQ(info.minClientQueueSize, 0u) << "adaptive sizing without maximum";
+    EXPECT_EQ(info.maxClientQueueSize, 0u) << "adaptive sizing without maximum";
+}
+
+TEST(LinkParserTest, clientQueueSize_adaptiveWithMaximum) {
+    ClientQueueVariables vars(1.5, 3, 100);
+    linkInfo info;
+    info.queueSize = 10;
+    info.clientQueueSize = 0;
+    setClientQueueSize(info);
+    EXPECT_EQ(info.clientQueueSize, 15u) << "computed client queue size wrong";
+    EXPECT_EQ(info.minClientQueueSize, 3u) << "adaptive minimum wrong";
+    EXPECT_EQ(info.maxClientQueueSize, 100u) << "adaptive maximum wrong";
+}
+
+TEST(LinkParserTest, clientQueueSize_explicitSizeNotAdaptive) {
+    ClientQueueVariables vars(1.5, 3, 100);
+    linkInfo info;
+    info.queueSize = 10;
+    info.clientQueueSize = 20; // cqsize=20
+    setClientQueueSize(info);
+    EXPECT_EQ(info.clientQueueSize, 20u) << "explicit client queue size changed";
+    EXPECT_EQ(info.minClientQueueSize, 0u) << "adaptive sizing for explicit size";
+    EXPECT_EQ(info.maxClientQueueSize, 0u) << "adaptive sizing for explicit size";
+}
+
+TEST(LinkParserTest, clientQueueSize_adaptiveFloorAtLeast2) {
+    ClientQueueVariables vars(1.5, 0, 100);
+    linkInfo info;
+    info.queueSize = 4;
+    info.clientQueueSize = 0;
+    setClientQueueSize(info);
+    EXPECT_EQ(info.clientQueueSize, 6u) << "computed client queue size wrong";
+    EXPECT_EQ(info.minClientQueueSize, 2u) << "adaptive minimum below 2";
+    EXPECT_EQ(info.maxClientQueueSize, 100u) << "adaptive maximum wrong";
+}
+
 } // namespace
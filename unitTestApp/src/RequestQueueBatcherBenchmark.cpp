@@ -0,0 +1,237 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <memory>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <cstdlib>
+#include <gtest/gtest.h>
+
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <menuPriority.h>
+
+#include "devOpcua.h"
+#include "MpscQueue.h"
+#include "RequestQueueBatcher.h"
+
+// Contention benchmark for the request queues of the RequestQueueBatcher.
+// Compares the lock-free MPSC queue against the mutex protected std::queue
+// that was used before, with 1 to 16 producer threads and one consumer.
+// Also counts the heap allocations on the request path (pooled cargo vs. new cargo per request).
+// Not run as part of the regular test suite - results are printed on stdout.
+
+// Global allocation counter (replacing the global operator new/delete)
+static std::atomic<size_t> allocations(0);
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using namespace DevOpcua;
+
+const unsigned int requestsPerRun = 400000;
+const unsigned int producerThreads[] = { 1, 2, 4, 8, 16 };
+
+struct TestCargo {
+    TestCargo(unsigned int val) : tag(val) {}
+    unsigned int tag;
+};
+
+// Reference implementation: the previous mutex protected queue
+class LockedQueue
+{
+public:
+    bool push(std::shared_ptr<TestCargo> cargo)
+    {
+        Guard G(lock);
+        q.push(std::move(cargo));
+        return true;
+    }
+    bool pop(std::shared_ptr<TestCargo> &cargo)
+    {
+        Guard G(lock);
+        if (q.empty())
+            return false;
+        cargo = std::move(q.front());
+        q.pop();
+        return true;
+    }
+private:
+    epicsMutex lock;
+    std::queue<std::shared_ptr<TestCargo>> q;
+};
+
+// Runs producers pushing requestsPerRun elements in total and one consumer popping them.
+// Returns the overall throughput [requests/s]
+template<typename Q>
+double
+runQueue(Q &queue, const unsigned int producers)
+{
+    std::vector<std::shared_ptr<TestCargo>> cargo;
+    cargo.reserve(requestsPerRun);
+    for (unsigned int i = 0; i < requestsPerRun; i++)
+        cargo.emplace_back(std::make_shared<TestCargo>(i));
+
+    std::atomic<bool> go(false);
+    unsigned int received = 0;
+    const unsigned int perProducer = requestsPerRun / producers;
+    const unsigned int total = perProducer * producers;
+
+    std::thread consumer([&]() {
+        std::shared_ptr<TestCargo> c;
+        while (!go) std::this_thread::yield();
+        while (received < total) {
+            if (queue.pop(c))
+                received++;
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (unsigned int p = 0; p < producers; p++)
+        threads.emplace_back([&, p]() {
+            while (!go) std::this_thread::yield();
+            for (unsigned int i = p * perProducer; i < (p + 1) * perProducer; i++)
+                queue.push(cargo[i]);
+        });
+
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto &t : threads)
+        t.join();
+    consumer.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(received, total) << "Not all requests received by consumer";
+    return total / elapsed.count();
+}
+
+TEST(RQBBenchmark, queuePushPop_LockedVsLockFree) {
+    std::cout << std::setw(10) << "producers"
+              << std::setw(16) << "locked [req/s]"
+              << std::setw(18) << "lock-free [req/s]"
+              << std::setw(8) << "gain" << std::endl;
+    for (auto producers : producerThreads) {
+        LockedQueue lq;
+        MpscQueue<TestCargo> mq;
+        double locked = runQueue(lq, producers);
+        double lockFree = runQueue(mq, producers);
+        EXPECT_TRUE(mq.empty()) << "MPSC queue not empty after run";
+        std::cout << std::setw(10) << producers
+                  << std::setw(16) << std::fixed << std::setprecision(0) << locked
+                  << std::setw(18) << lockFree
+                  << std::setw(8) << std::setprecision(2) << lockFree / locked << std::endl;
+    }
+}
+
+class CountingConsumer : public RequestConsumer<TestCargo> {
+public:
+    CountingConsumer() : count(0), total(0) {}
+    virtual void processRequests(std::vector<std::shared_ptr<TestCargo>> &batch) override
+    {
+        count += static_cast<unsigned int>(batch.size());
+        if (count >= total)
+            finished.signal();
+    }
+    unsigned int count;
+    unsigned int total;
+    epicsEvent finished;
+};
+
+TEST(RQBBenchmark, batcherEndToEnd_1To16Producers) {
+    std::cout << std::setw(10) << "producers"
+              << std::setw(18) << "batcher [req/s]" << std::endl;
+    for (auto producers : producerThreads) {
+        CountingConsumer consumer;
+        RequestQueueBatcher<TestCargo> b("benchmark batcher", consumer, 1000);
+        const unsigned int perProducer = requestsPerRun / producers;
+        consumer.total = perProducer * producers;
+
+        std::atomic<bool> go(false);
+        std::vector<std::thread> threads;
+        for (unsigned int p = 0; p < producers; p++)
+            threads.emplace_back([&, p]() {
+                while (!go) std::this_thread::yield();
+                for (unsigned int i = 0; i < perProducer; i++)
+                    b.pushRequest(std::make_shared<TestCargo>(i), static_cast<menuPriority>((p + i) % 3));
+            });
+
+        auto start = std::chrono::steady_clock::now();
+        go = true;
+        for (auto &t : threads)
+            t.join();
+        consumer.finished.wait();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        EXPECT_EQ(consumer.count, consumer.total) << "Not all requests delivered";
+        std::cout << std::setw(10) << producers
+                  << std::setw(18) << std::fixed << std::setprecision(0)
+                  << consumer.total / elapsed.count() << std::endl;
+    }
+}
+
+// Pushes allocRequests requests through a batcher (after a warm-up run of the same size)
+// and returns the number of heap allocations per 1000 requests
+double
+runAllocations(const bool pooled)
+{
+    const unsigned int allocRequests = 10000;
+    CountingConsumer consumer;
+    RequestQueueBatcher<TestCargo> b("allocation batcher", consumer, 100);
+    std::vector<std::shared_ptr<TestCargo>> cargo;
+    if (pooled)
+        for (unsigned int i = 0; i < 100; i++)
+            cargo.emplace_back(std::make_shared<TestCargo>(i));
+
+    size_t count = 0;
+    for (unsigned int run = 0; run < 2; run++) {
+        consumer.count = 0;
+        consumer.total = allocRequests;
+        size_t before = allocations.load();
+        for (unsigned int i = 0; i < allocRequests; i++) {
+            if (pooled)
+                b.pushRequest(cargo[i % cargo.size()], menuPriorityLOW);
+            else
+                b.pushRequest(std::make_shared<TestCargo>(i), menuPriorityLOW);
+            // Limit the queue fill level (the pooled cargo elements must not be queued twice)
+            if (b.size(menuPriorityLOW) >= 50)
+                while (b.size(menuPriorityLOW)) std::this_thread::yield();
+        }
+        consumer.finished.wait();
+        count = allocations.load() - before;
+    }
+    return count * 1000.0 / allocRequests;
+}
+
+TEST(RQBBenchmark, allocationsPerRequest_PooledVsNew) {
+    double pooled = runAllocations(true);
+    double fresh = runAllocations(false);
+    std::cout << std::setw(26) << "allocations/1000 requests"
+              << std::setw(10) << "pooled" << std::setw(10) << std::fixed << std::setprecision(1) << pooled
+              << std::setw(16) << "new cargo" << std::setw(10) << fresh << std::endl;
+    EXPECT_LT(pooled, fresh) << "Pooled request path allocates more than the non-pooled path";
+}
+
+} // namespace
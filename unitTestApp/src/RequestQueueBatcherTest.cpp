@@ -46,11 +46,13 @@ public:
 
 class TestDumper : public RequestConsumer<TestCargo> {
 public:
-    TestDumper() {}
+    TestDumper() : cost(0) {}
     virtual ~TestDumper() {}
     virtual void processRequests(std::vector<std::shared_ptr<TestCargo>> &batch) override;
+    virtual size_t requestCost(const TestCargo &cargo) override { (void)cargo; return cost; }
     void reset() {
         noOfBatches = 0;
+        cost = 0;
         batchSizes.clear();
         batchData.clear();
         nextTimeAdd = 2;
@@ -58,6 +60,7 @@ public:
     }
 
     epicsEvent finished;
+    size_t cost;
     unsigned int noOfBatches;
     std::vector<unsigned int> batchSizes;
     std::vector<std::pair<double, std::vector<unsigned int>>> batchData;
@@ -431,6 +434,378 @@ TEST_F(RQBBatcherTest, size10HoldOff_20RequestsVaryingBatchesAfterParamChange) {
     }
 }
 
+TEST_F(RQBBatcherTest, adaptive_DecreaseOnSlowIncreaseOnFast) {
+    b1000.setParams(1000, 2, 20);
+    b1000.setLatencyTarget(50);
+
+    EXPECT_EQ(b1000.latencyTargetMs(), 50u) << "latency target parameter wrong";
+    EXPECT_EQ(b1000.currentMaxRequests(), 1000u) << "adaptive mode does not start at configured batch size";
+    EXPECT_DOUBLE_EQ(b1000.currentHoldOff(), 2.0) << "adaptive mode does not start at min holdoff";
+
+    b1000.reportLatency(0.2, 1000);
+    EXPECT_EQ(b1000.currentMaxRequests(), 500u) << "batch size not halved after slow batch";
+    EXPECT_DOUBLE_EQ(b1000.currentHoldOff(), 4.0) << "holdoff not doubled after slow batch";
+
+    b1000.reportLatency(0.2, 1000); // sent before the decrease: ignored
+    EXPECT_EQ(b1000.currentMaxRequests(), 500u) << "slow batch sent before last decrease not ignored";
+
+    b1000.reportLatency(0.01, 500);
+    EXPECT_EQ(b1000.currentMaxRequests(), 531u) << "batch size not increased after fast full batch";
+    EXPECT_DOUBLE_EQ(b1000.currentHoldOff(), 3.0) << "holdoff not decreased after fast batch";
+
+    b1000.reportLatency(0.01, 10);
+    EXPECT_EQ(b1000.currentMaxRequests(), 531u) << "batch size increased after fast partial batch";
+
+    for (int i = 0; i < 100; i++)
+        b1000.reportLatency(0.2, 1);
+    EXPECT_EQ(b1000.currentMaxRequests(), 1u) << "batch size not at lower limit after many slow batches";
+    EXPECT_DOUBLE_EQ(b1000.currentHoldOff(), 50.0) << "holdoff not limited by max(maxHoldOff, target)";
+
+    for (int i = 0; i < 2000; i++)
+        b1000.reportLatency(0.01, b1000.currentMaxRequests());
+    EXPECT_EQ(b1000.currentMaxRequests(), 1000u) << "batch size not at configured limit after many fast batches";
+    EXPECT_DOUBLE_EQ(b1000.currentHoldOff(), 2.0) << "holdoff not at min holdoff after many fast batches";
+    EXPECT_NEAR(b1000.averageLatency(), 10.0, 0.1) << "average latency wrong";
+
+    b1000.setLatencyTarget(0);
+    b1000.reportLatency(0.2, 1000);
+    EXPECT_EQ(b1000.currentMaxRequests(), 1000u) << "batch size changed with adaptive mode off";
+}
+
+TEST_F(RQBBatcherTest, adaptive_BatchesLimitedByCurrentSize) {
+    b10.setLatencyTarget(50);
+    b10.reportLatency(0.2, 10);
+    b10.reportLatency(0.2, 5);
+    EXPECT_EQ(b10.currentMaxRequests(), 2u) << "batch size not reduced to 2";
+
+    addRequests(b10, menuPriorityLOW, 9);
+    b10.startWorker();
+    pushFinish_waitForDump(b10);
+
+    EXPECT_EQ(dump.noOfBatches, 5u) << "Cargo not processed in 5 batches";
+    EXPECT_THAT(dump.batchSizes, Each(Le(2u))) << "Some batches are exceeding the adaptive size limit";
+}
+
+TEST_F(RQBBatcherTest, window2_SendingDrivenByCompletions) {
+    b10.setWindow(2);
+    EXPECT_EQ(b10.window(), 2u) << "window parameter wrong";
+
+    addRequests(b10, menuPriorityLOW, 39);
+    b10.startWorker();
+    epicsThread::sleep(0.1);
+
+    EXPECT_EQ(dump.noOfBatches, 2u) << "more batches sent than the window allows";
+    EXPECT_EQ(b10.outstandingBatches(), 2u) << "wrong number of outstanding batches";
+    EXPECT_EQ(b10.size(menuPriorityLOW), 19u) << "Queue[LOW] returns wrong size";
+
+    b10.completeBatch(b10.batchGeneration());
+    epicsThread::sleep(0.1);
+    EXPECT_EQ(dump.noOfBatches, 3u) << "completion did not trigger exactly one batch";
+    EXPECT_EQ(b10.outstandingBatches(), 2u) << "wrong number of outstanding batches";
+
+    // push the finish marker while blocked, so that the rest fits in one batch
+    b10.pushRequest(std::make_shared<TestCargo>(TAG_FINISHED), menuPriorityLOW);
+    b10.setWindow(0);
+    dump.finished.wait();
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+    EXPECT_EQ(dump.noOfBatches, 4u) << "Cargo not processed in 4 batches";
+    EXPECT_EQ(b10.size(menuPriorityLOW), 0u) << "Queue[LOW] returns wrong size";
+}
+
+TEST_F(RQBBatcherTest, window1_ClearResetsOutstanding) {
+    b10.setWindow(1);
+    addRequests(b10, menuPriorityLOW, 15);
+    b10.startWorker();
+    epicsThread::sleep(0.1);
+    EXPECT_EQ(dump.noOfBatches, 1u) << "more batches sent than the window allows";
+
+    b10.clear();
+    EXPECT_EQ(b10.outstandingBatches(), 0u) << "clear() did not reset outstanding batches";
+    allSentCargo.erase(allSentCargo.begin() + 10, allSentCargo.end()); // cleared, not sent
+
+    pushFinish_waitForDump(b10);
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+    EXPECT_EQ(dump.noOfBatches, 2u) << "batcher not sending after clear()";
+}
+
+TEST_F(RQBBatcherTest, window1_LateCompletionAfterClearIgnored) {
+    b10.setWindow(1);
+    addRequestVector(b10, menuPriorityLOW, 5);
+    b10.startWorker();
+    epicsThread::sleep(0.1);
+    const unsigned int lost = b10.batchGeneration();
+
+    b10.clear();
+    addRequestVector(b10, menuPriorityLOW, 15);
+    epicsThread::sleep(0.1);
+    EXPECT_EQ(dump.noOfBatches, 2u) << "batcher not sending after clear()";
+    EXPECT_NE(b10.batchGeneration(), lost) << "clear() did not start a new generation";
+
+    b10.completeBatch(lost); // late completion of the batch sent before clear()
+    epicsThread::sleep(0.1);
+    EXPECT_EQ(dump.noOfBatches, 2u) << "late completion from before clear() returned a credit";
+    EXPECT_EQ(b10.outstandingBatches(), 1u) << "wrong number of outstanding batches";
+
+    b10.pushRequest(std::make_shared<TestCargo>(TAG_FINISHED), menuPriorityLOW);
+    b10.completeBatch(b10.batchGeneration());
+    dump.finished.wait();
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+    EXPECT_EQ(dump.noOfBatches, 3u) << "completion did not trigger the next batch";
+}
+
+TEST_F(RQBBatcherTest, weighted_NoStarvationProportionalShares) {
+    const unsigned int weights[menuPriority_NUM_CHOICES] = { 1, 2, 4 };
+    b10.setWeights(weights);
+    EXPECT_EQ(b10.getWeight(menuPriorityMEDIUM), 2u) << "weight parameter wrong";
+
+    addRequests(b10, menuPriorityLOW, 30);
+    addRequests(b10, menuPriorityMEDIUM, 30);
+    addRequests(b10, menuPriorityHIGH, 30);
+
+    b10.startWorker();
+    pushFinish_waitForDump(b10);
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+
+    EXPECT_EQ(allSentCargo.size(), 90u) << "Not all cargo sent";
+    EXPECT_THAT(dump.batchSizes, Each(Le(10u))) << "Some batches are exceeding the size limit";
+
+    // First batch: DRR rounds give HIGH 4+3, MEDIUM 2, LOW 1
+    unsigned int perPrio[menuPriority_NUM_CHOICES] = { 0, 0, 0 };
+    for (auto tag : dump.batchData[0].second)
+        perPrio[tag >= 2000000 ? menuPriorityLOW : tag >= 1000000 ? menuPriorityMEDIUM : menuPriorityHIGH]++;
+    EXPECT_EQ(perPrio[menuPriorityHIGH], 7u) << "HIGH share of first batch wrong";
+    EXPECT_EQ(perPrio[menuPriorityMEDIUM], 2u) << "MEDIUM share of first batch wrong";
+    EXPECT_EQ(perPrio[menuPriorityLOW], 1u) << "LOW starved in first batch";
+
+    EXPECT_EQ(b10.dequeued(menuPriorityLOW), 31lu) << "wrong number of dequeued LOW requests";
+    EXPECT_EQ(b10.dequeued(menuPriorityMEDIUM), 30lu) << "wrong number of dequeued MEDIUM requests";
+    EXPECT_EQ(b10.dequeued(menuPriorityHIGH), 30lu) << "wrong number of dequeued HIGH requests";
+    EXPECT_GE(b10.maxWait(menuPriorityLOW), b10.averageWait(menuPriorityLOW)) << "max wait < average wait";
+
+    b10.resetWaitStats();
+    EXPECT_EQ(b10.dequeued(menuPriorityLOW), 0lu) << "wait statistics not reset";
+}
+
+TEST_F(RQBBatcherTest, weighted_SmallBatchesNoStarvation) {
+    const unsigned int weights[menuPriority_NUM_CHOICES] = { 1, 2, 4 };
+    // batch limits below the HIGH weight
+    RequestQueueBatcher<TestCargo> *batchers[] = { &b1000, &b10 };
+    for (unsigned int max = 1; max <= 2; max++) {
+        RequestQueueBatcher<TestCargo> &b = *batchers[max - 1];
+        dump.reset();
+        b.setParams(max);
+        b.setWeights(weights);
+
+        // HIGH saturated: more than the checked batches can take
+        addRequests(b, menuPriorityHIGH, 40);
+        addRequests(b, menuPriorityMEDIUM, 4);
+        addRequests(b, menuPriorityLOW, 4);
+
+        b.startWorker();
+        pushFinish_waitForDump(b);
+
+        // a DRR round (4 HIGH, 2 MEDIUM, 1 LOW) fits into 7 / max (rounded up) + 1 batches
+        const unsigned int batches = 2 * ((7 + max - 1) / max + 1);
+        unsigned int perPrio[menuPriority_NUM_CHOICES] = { 0, 0, 0 };
+        ASSERT_GE(dump.batchData.size(), batches) << "too few batches sent";
+        for (unsigned int i = 0; i < batches; i++) {
+            EXPECT_LE(dump.batchSizes[i], max) << "Batch[" << i << "] is exceeding the size limit";
+            for (auto tag : dump.batchData[i].second)
+                perPrio[tag >= 2000000 ? menuPriorityLOW : tag >= 1000000 ? menuPriorityMEDIUM : menuPriorityHIGH]++;
+        }
+        EXPECT_GE(perPrio[menuPriorityMEDIUM], 4u) << "MEDIUM starved by saturated HIGH (max " << max << ")";
+        EXPECT_GE(perPrio[menuPriorityLOW], 2u) << "LOW starved by saturated HIGH (max " << max << ")";
+    }
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+}
+
+TEST_F(RQBBatcherTest, ageLimit_PartialBatchHeldUntilOldestTooOld) {
+    b10.setAgeLimit(300);
+    EXPECT_EQ(b10.getAgeLimit(), 300u) << "age limit parameter wrong";
+    b10.startWorker();
+
+    addRequests(b10, menuPriorityLOW, 3);
+    epicsThread::sleep(0.1);
+    EXPECT_EQ(dump.noOfBatches, 0u) << "partial batch not held back";
+    epicsThread::sleep(0.4);
+    EXPECT_EQ(dump.noOfBatches, 1u) << "partial batch not sent after age limit";
+    EXPECT_EQ(dump.batchSizes[0], 3u) << "Batch[0] has wrong size";
+
+    addRequests(b10, menuPriorityMEDIUM, 4);
+    addRequests(b10, menuPriorityHIGH, 6);
+    epicsThread::sleep(0.1);
+    EXPECT_EQ(dump.noOfBatches, 2u) << "full batch not sent immediately";
+    EXPECT_EQ(dump.batchSizes[1], 10u) << "Batch[1] is not full";
+    EXPECT_GE(b10.maxWait(menuPriorityLOW), 300.0) << "request sent before reaching age limit";
+
+    b10.setAgeLimit(0);
+    pushFinish_waitForDump(b10);
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+    EXPECT_EQ(dump.noOfBatches, 3u) << "Cargo not processed in 3 batches";
+    EXPECT_EQ(dump.batchSizes[2], 1u) << "Batch[2] has wrong size";
+}
+
+TEST_F(RQBBatcherTest, byteBudget_BatchesLimitedByCost) {
+    dump.cost = 100;
+    b10.setMaxBytes(350);
+    EXPECT_EQ(b10.maxBytes(), 350u) << "byte budget parameter wrong";
+
+    addRequests(b10, menuPriorityLOW, 10);
+    addRequests(b10, menuPriorityHIGH, 10);
+    // push the finish marker
+    b10.pushRequest(std::make_shared<TestCargo>(TAG_FINISHED), menuPriorityLOW);
+    b10.startWorker();
+    dump.finished.wait();
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+
+    EXPECT_EQ(allSentCargo.size(), 20u) << "Not all cargo sent";
+    EXPECT_EQ(dump.noOfBatches, 7u) << "Cargo not processed in 7 batches";
+    EXPECT_THAT(dump.batchSizes, Each(Le(3u))) << "Some batches are exceeding the byte budget";
+    EXPECT_EQ(b10.budgetLimitedBatches(), 6lu) << "wrong number of budget limited batches";
+
+    // A request exceeding the budget on its own is sent by itself
+    b10.setMaxBytes(50);
+    addRequests(b10, menuPriorityLOW, 2);
+    pushFinish_waitForDump(b10);
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+    EXPECT_EQ(dump.noOfBatches, 10u) << "oversized requests not sent in single batches";
+}
+
+TEST_F(RQBBatcherTest, requestsCap_LimitsBatchSize) {
+    b10.setRequestsCap(4);
+    EXPECT_EQ(b10.getRequestsCap(), 4u) << "requests cap parameter wrong";
+    EXPECT_EQ(b10.currentMaxRequests(), 4u) << "requests cap not applied to current limit";
+
+    addRequests(b10, menuPriorityLOW, 10);
+    // push the finish marker
+    b10.pushRequest(std::make_shared<TestCargo>(TAG_FINISHED), menuPriorityLOW);
+    b10.startWorker();
+    dump.finished.wait();
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+
+    EXPECT_EQ(allSentCargo.size(), 10u) << "Not all cargo sent";
+    EXPECT_EQ(dump.noOfBatches, 3u) << "Cargo not processed in 3 batches";
+    EXPECT_THAT(dump.batchSizes, Each(Le(4u))) << "Some batches are exceeding the requests cap";
+}
+
+TEST_F(RQBBatcherTest, requestsCap_RelaxedAfterSuccessfulFullBatches) {
+    const unsigned int relaxAfter = RequestQueueBatcher<TestCargo>::capRelaxBatches;
+    b100.setRequestsCap(40);
+
+    for (unsigned int i = 0; i < 2 * relaxAfter; i++)
+        b100.reportSuccess(20);
+    EXPECT_EQ(b100.getRequestsCap(), 40u) << "cap relaxed after partial batches";
+
+    for (unsigned int i = 0; i < relaxAfter - 1; i++)
+        b100.reportSuccess(40);
+    EXPECT_EQ(b100.getRequestsCap(), 40u) << "cap relaxed too early";
+    b100.reportSuccess(40);
+    EXPECT_EQ(b100.getRequestsCap(), 45u) << "cap not relaxed after successful full batches";
+
+    for (unsigned int i = 0; i < relaxAfter - 1; i++)
+        b100.reportSuccess(45);
+    b100.setRequestsCap(30); // learning a lower cap restarts counting
+    b100.reportSuccess(30);
+    EXPECT_EQ(b100.getRequestsCap(), 30u) << "success count not reset by setRequestsCap()";
+
+    for (unsigned int round = 0; round < 20; round++)
+        for (unsigned int i = 0; i < relaxAfter; i++)
+            b100.reportSuccess(100);
+    EXPECT_EQ(b100.getRequestsCap(), 0u) << "cap not removed when reaching the configured limit";
+}
+
+TEST_F(RQBBatcherTest, rateLimited_CallsThrottledByTokenBucket) {
+    TokenBucket calls;
+    calls.setRate(20.0, 1.0);
+    b10.setRateLimiters(&calls, nullptr);
+
+    addRequests(b10, menuPriorityLOW, 50);
+    // push the finish marker
+    b10.pushRequest(std::make_shared<TestCargo>(TAG_FINISHED), menuPriorityLOW);
+    epicsTime start = epicsTime::getCurrent();
+    b10.startWorker();
+    dump.finished.wait();
+    double elapsed = epicsTime::getCurrent() - start;
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+    b10.setRateLimiters(nullptr, nullptr);
+
+    EXPECT_EQ(dump.noOfBatches, 6u) << "Cargo not processed in 6 batches";
+    EXPECT_GE(elapsed, 0.24) << "6 batches sent faster than 20 calls/s (burst 1)";
+    EXPECT_EQ(calls.noOfTakes(), 6lu) << "wrong number of call tokens taken";
+    EXPECT_EQ(calls.noOfThrottled(), 5lu) << "wrong number of throttled calls";
+}
+
+TEST_F(RQBBatcherTest, express_HighBypassesHoldOff) {
+    RequestQueueBatcher<TestCargo> bx("test batcher express", dump, 10, 500, 500);
+    bx.setExpress(true);
+    EXPECT_TRUE(bx.getExpress()) << "express lane parameter wrong";
+
+    addRequests(bx, menuPriorityLOW, 3);
+    epicsThread::sleep(0.1);
+    EXPECT_EQ(dump.noOfBatches, 1u) << "first batch not sent";
+
+    addRequests(bx, menuPriorityLOW, 2);
+    addRequests(bx, menuPriorityHIGH, 1);
+    epicsThread::sleep(0.1);
+    EXPECT_EQ(dump.noOfBatches, 2u) << "express request not sent during hold-off";
+    EXPECT_EQ(dump.batchSizes[1], 1u) << "express batch contains regular requests";
+    EXPECT_EQ(bx.noOfExpressBatches(), 1lu) << "wrong number of express batches";
+    EXPECT_LT(bx.maxExpressWait(), 100.0) << "express request waited too long";
+
+    pushFinish_waitForDump(bx);
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+    EXPECT_EQ(dump.noOfBatches, 3u) << "Cargo not processed in 3 batches";
+    EXPECT_EQ(dump.batchSizes[2], 3u) << "regular requests not held back by hold-off";
+}
+
+TEST_F(RQBBatcherTest, express_BudgetAndRateLimited) {
+    RequestQueueBatcher<TestCargo> bx("test batcher express", dump, 10, 500, 500);
+    TokenBucket calls;
+    calls.setRate(20.0, 1.0);
+    bx.setRateLimiters(&calls, nullptr);
+    dump.cost = 10;
+    bx.setMaxBytes(20);
+    bx.setExpress(true);
+
+    addRequests(bx, menuPriorityLOW, 1);
+    epicsThread::sleep(0.1);
+    EXPECT_EQ(dump.noOfBatches, 1u) << "first batch not sent";
+
+    // during the hold-off: 3 express batches of 2, throttled to 20 calls/s
+    // (the bucket has refilled for the first one)
+    epicsTime start = epicsTime::getCurrent();
+    addRequestVector(bx, menuPriorityHIGH, 6);
+    while (dump.noOfBatches < 4 && epicsTime::getCurrent() - start < 0.35)
+        epicsThread::sleep(0.005);
+    double elapsed = epicsTime::getCurrent() - start;
+    EXPECT_EQ(dump.noOfBatches, 4u) << "express requests not sent during hold-off";
+    EXPECT_EQ(bx.noOfExpressBatches(), 3lu) << "wrong number of express batches";
+    for (unsigned int i = 1; i < dump.batchSizes.size(); i++)
+        EXPECT_EQ(dump.batchSizes[i], 2u) << "express batch[" << i << "] not limited by byte budget";
+    EXPECT_GE(bx.budgetLimitedBatches(), 2lu) << "express batches not counted as budget limited";
+    EXPECT_GE(elapsed, 0.09) << "express batches sent faster than 20 calls/s (burst 1)";
+    EXPECT_EQ(calls.noOfThrottled(), 2lu) << "express batches not throttled";
+
+    pushFinish_waitForDump(bx);
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+    bx.setRateLimiters(nullptr, nullptr);
+}
+
+TEST_F(RQBBatcherTest, express_StatsCoverHighInRegularBatches) {
+    b10.setExpress(true);
+
+    // no hold-off: the HIGH requests are picked up by a regular batch
+    addRequests(b10, menuPriorityHIGH, 3);
+    epicsThread::sleep(0.05);
+    b10.startWorker();
+    pushFinish_waitForDump(b10);
+    epicsThread::sleep(0.05); // to let the batcher drop the shared_ptr references
+
+    EXPECT_EQ(b10.noOfExpressBatches(), 0lu) << "regular batch counted as express batch";
+    EXPECT_GE(b10.maxExpressWait(), 40.0) << "HIGH request in regular batch not in express statistics";
+    EXPECT_GE(b10.averageExpressWait(), 40.0) << "HIGH request in regular batch not in express statistics";
+}
+
 // Replacing libCom's epicsThreadSleep();
 
 void
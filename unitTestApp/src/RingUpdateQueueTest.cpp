@@ -0,0 +1,550 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <gtest/gtest.h>
+
+#include <epicsTime.h>
+
+#include "RingUpdateQueue.h"
+#include "Update.h"
+
+namespace {
+
+using namespace DevOpcua;
+
+typedef Update<int, unsigned short> TestUpdate;
+
+// Fixture for testing RingUpdateQueue (empty, sizes 5 and 3, discard oldest)
+class RingUpdateQueueTest : public ::testing::Test {
+protected:
+    RingUpdateQueueTest()
+        : q0(5ul)
+        , q1(3ul)
+        , q2(3ul, false)
+    {}
+
+    virtual void SetUp() override {
+        ts00.getCurrent();
+        std::shared_ptr<TestUpdate> u0(new TestUpdate(ts00, ProcessReason::writeComplete, 0, 100));
+        ts01 = ts00 + 1.0;
+        std::shared_ptr<TestUpdate> u1(new TestUpdate(ts01, ProcessReason::incomingData, 1, 101));
+        ts02 = ts00 + 2.0;
+        std::shared_ptr<TestUpdate> u2(new TestUpdate(ts02, ProcessReason::readComplete, 2, 102));
+
+        q1.pushUpdate(u0);
+        q1.pushUpdate(u1);
+        q1.pushUpdate(u2);
+
+        q2.pushUpdate(u0);
+        q2.pushUpdate(u1);
+        q2.pushUpdate(u2);
+    }
+    // virtual void TearDown() override {}
+    epicsTime ts00;
+    epicsTime ts01;
+    epicsTime ts02;
+    RingUpdateQueue<TestUpdate> q0;
+    RingUpdateQueue<TestUpdate> q1;
+    RingUpdateQueue<TestUpdate> q2;
+};
+
+TEST_F(RingUpdateQueueTest, status_EmptyQueue_IsCorrect) {
+    EXPECT_EQ(q0.size(), 0lu) << "Empty update queue returns size " << q0.size();
+    EXPECT_EQ(q0.empty(), true) << "Empty update queue returns empty() as false";
+    EXPECT_EQ(q0.capacity(), 5ul) << "Queue of size 5 reports " << q0.capacity() << " as capacity";
+    EXPECT_EQ(q1.capacity(), 3ul) << "Queue of size 3 reports " << q0.capacity() << " as capacity";
+}
+
+TEST_F(RingUpdateQueueTest, status_UsedQueue_IsCorrect) {
+    epicsTime ts0;
+    ts0.getCurrent();
+    std::shared_ptr<TestUpdate> u0(new TestUpdate(ts0, ProcessReason::incomingData, 0, 100));
+    epicsTime ts1 = ts0 + 1.0;
+    std::shared_ptr<TestUpdate> u1(new TestUpdate(ts1, ProcessReason::writeComplete, 1, 101));
+    q0.pushUpdate(u0);
+    q0.pushUpdate(u1);
+
+    EXPECT_EQ(q0.size(), 2lu) << "With two updates, update queue returns size " << q0.size() << " not 2";
+    EXPECT_EQ(q0.empty(), false) << "With two updates, update queue returns empty() as true";
+}
+
+TEST_F(RingUpdateQueueTest, popUpdate_UsedQueue_DataAndOrderCorrect) {
+    int i;
+    epicsTime ts0;
+    ts0.getCurrent();
+    std::shared_ptr<TestUpdate> u0(new TestUpdate(ts0, ProcessReason::incomingData, 0, 100));
+    epicsTime ts1 = ts0 + 1.0;
+    std::shared_ptr<TestUpdate> u1(new TestUpdate(ts1, ProcessReason::writeComplete, 1, 101));
+    epicsTime ts2 = ts0 + 2.0;
+    std::shared_ptr<TestUpdate> u2(new TestUpdate(ts2, ProcessReason::readComplete, 2, 102));
+    q0.pushUpdate(u0);
+    q0.pushUpdate(u1);
+    q0.pushUpdate(u2);
+
+    EXPECT_EQ(q0.size(), 3lu) << "With 3 updates, update queue returns size " << q0.size() << " not 3";
+
+    std::shared_ptr<TestUpdate> r0 = q0.popUpdate();
+    EXPECT_EQ(q0.size(), 2lu) << "With 2 updates remaining, update queue returns size " << q0.size() << " not 2";
+    EXPECT_EQ(r0->getOverrides(), 0ul) << "Update 0 override counter (" << r0->getOverrides() << ") not 0";
+    EXPECT_EQ(r0->getTimeStamp(), ts0) << "Update 0 timestamp is not as before";
+    EXPECT_EQ(r0->getType(), ProcessReason::incomingData) << "Update 0 ProcessReason is not as before";
+    EXPECT_EQ(r0->getStatus(), 100) << "Update 0 status is not as before";
+    i = r0->getData();
+    EXPECT_EQ(i, 0) << "Update 0 data (" << i << ") differs from original data (0)";
+
+    r0 = q0.popUpdate();
+    EXPECT_EQ(q0.size(), 1lu) << "With 1 update remaining, update queue returns size " << q0.size() << " not 1";
+    EXPECT_EQ(r0->getOverrides(), 0ul) << "Update 1 override counter (" << r0->getOverrides() << ") not 0";
+    EXPECT_EQ(r0->getTimeStamp(), ts1) << "Update 1 timestamp is not as before";
+    EXPECT_EQ(r0->getType(), ProcessReason::writeComplete) << "Update 1 ProcessReason is not as before";
+    EXPECT_EQ(r0->getStatus(), 101) << "Update 1 status is not as before";
+    i = r0->getData();
+    EXPECT_EQ(i, 1) << "Update 1 data (" << i << ") differs from original data (1)";
+
+    r0 = q0.popUpdate();
+    EXPECT_EQ(q0.size(), 0lu) << "With 0 updates remaining, update queue returns size " << q0.size() << " not 0";
+    EXPECT_EQ(r0->getOverrides(), 0ul) << "Update 2 override counter (" << r0->getOverrides() << ") not 0";
+    EXPECT_EQ(r0->getTimeStamp(), ts2) << "Update 2 timestamp is not as before";
+    EXPECT_EQ(r0->getType(), ProcessReason::readComplete) << "Update 2 ProcessReason is not as before";
+    EXPECT_EQ(r0->getStatus(), 102) << "Update 2 status is not as before";
+    i = r0->getData();
+    EXPECT_EQ(i, 2) << "Update 2 data (" << i << ") differs from original data (2)";
+}
+
+TEST_F(RingUpdateQueueTest, popUpdate_UsedQueue_nextReasonIsCorrect) {
+    epicsTime ts0;
+    ts0.getCurrent();
+    std::shared_ptr<TestUpdate> u0(new TestUpdate(ts0, ProcessReason::incomingData, 0, 100));
+    epicsTime ts1 = ts0 + 1.0;
+    std::shared_ptr<TestUpdate> u1(new TestUpdate(ts1, ProcessReason::writeComplete, 1, 101));
+    ProcessReason nextReason = ProcessReason::none;
+    std::shared_ptr<TestUpdate> r0;
+
+    q0.pushUpdate(u0);
+    q0.pushUpdate(u1);
+
+    r0 = q0.popUpdate(&nextReason);
+    EXPECT_EQ(nextReason, ProcessReason::writeComplete) << "Second-to-last pop does not set nextReason = writeComplete";
+    r0 = q0.popUpdate(&nextReason);
+    EXPECT_EQ(nextReason, ProcessReason::none) << "Last pop does not set nextReason = none";
+}
+
+TEST_F(RingUpdateQueueTest, pushUpdate_FullQueueOldest_OverrideAtOldEnd) {
+    std::shared_ptr<TestUpdate> r0;
+    epicsTime ts0;
+    ts0.getCurrent();
+    std::shared_ptr<TestUpdate> u0(new TestUpdate(ts0, ProcessReason::incomingData, 10, 110));
+    epicsTime ts1 = ts0 + 1.0;
+    std::shared_ptr<TestUpdate> u1(new TestUpdate(ts1, ProcessReason::writeComplete, 11, 111));
+    epicsTime ts2 = ts0 + 2.0;
+    std::shared_ptr<TestUpdate> u2(new TestUpdate(ts2, ProcessReason::readComplete, 12, 112));
+    q1.pushUpdate(u0);
+    q1.pushUpdate(u1);
+    q1.pushUpdate(u2);
+
+    r0 = q1.popUpdate();
+    EXPECT_EQ(q1.size(), 2lu) << "After pop 1/3, update queue returns size " << q1.size() << " not 2";
+    EXPECT_EQ(r0->getOverrides(), 3ul) << "Pop 1/3 override counter (" << r0->getOverrides() << ") not 3";
+    EXPECT_EQ(r0->getTimeStamp(), ts0) << "Pop 1/3 timestamp is not as from first added Update";
+    EXPECT_EQ(r0->getStatus(), 110) << "Pop 1/3 status is not as from first added Update";
+
+    r0 = q1.popUpdate();
+    EXPECT_EQ(q1.size(), 1lu) << "After pop 2/3, update queue returns size " << q1.size() << " not 1";
+    EXPECT_EQ(r0->getOverrides(), 0ul) << "Pop 2/3 override counter (" << r0->getOverrides() << ") not 0";
+    EXPECT_EQ(r0->getTimeStamp(), ts1) << "Pop 2/3 timestamp is not as from 2nd added Update";
+    EXPECT_EQ(r0->getStatus(), 111) << "Pop 2/3 status is not as from 2nd added Update";
+
+    r0 = q1.popUpdate();
+    EXPECT_EQ(q1.size(), 0lu) << "After pop 3/3, update queue returns size " << q1.size() << " not 0";
+    EXPECT_EQ(r0->getOverrides(), 0ul) << "Pop 3/3 override counter (" << r0->getOverrides() << ") not 0";
+    EXPECT_EQ(r0->getTimeStamp(), ts2) << "Pop 3/3 timestamp is not as from 3rd added Update";
+    EXPECT_EQ(r0->getStatus(), 112) << "Pop 3/3 status is not as from 3rd added Update";
+}
+
+TEST_F(RingUpdateQueueTest, pushUpdate_FullQueueNewest_OverrideAtNewEnd) {
+    std::shared_ptr<TestUpdate> r0;
+    epicsTime ts0;
+    ts0.getCurrent();
+    std::shared_ptr<TestUpdate> u0(new TestUpdate(ts0, ProcessReason::incomingData, 10, 110));
+    epicsTime ts1 = ts0 + 1.0;
+    std::shared_ptr<TestUpdate> u1(new TestUpdate(ts1, ProcessReason::writeComplete, 11, 111));
+    epicsTime ts2 = ts0 + 2.0;
+    std::shared_ptr<TestUpdate> u2(new TestUpdate(ts2, ProcessReason::readComplete, 12, 112));
+    q2.pushUpdate(u0);
+    q2.pushUpdate(u1);
+    q2.pushUpdate(u2);
+
+    r0 = q2.popUpdate();
+    EXPECT_EQ(q2.size(), 2lu) << "After pop 1/3, update queue returns size " << q2.size() << " not 2";
+    EXPECT_EQ(r0->getOverrides(), 0ul) << "Pop 1/3 override counter (" << r0->getOverrides() << ") not 0";
+    EXPECT_EQ(r0->getTimeStamp(), ts00) << "Pop 1/3 timestamp is not as from first original Update";
+    EXPECT_EQ(r0->getStatus(), 100) << "Pop 1/3 status is not as from first original Update";
+
+    r0 = q2.popUpdate();
+    EXPECT_EQ(q2.size(), 1lu) << "After pop 2/3, update queue returns size " << q2.size() << " not 1";
+    EXPECT_EQ(r0->getOverrides(), 0ul) << "Pop 2/3 override counter (" << r0->getOverrides() << ") not 0";
+    EXPECT_EQ(r0->getTimeStamp(), ts01) << "Pop 2/3 timestamp is not as from 2nd original Update";
+    EXPECT_EQ(r0->getStatus(), 101) << "Pop 2/3 status is not as from 2nd original Update";
+
+    r0 = q2.popUpdate();
+    EXPECT_EQ(q2.size(), 0lu) << "After pop 3/3, update queue returns size " << q2.size() << " not 0";
+    EXPECT_EQ(r0->getOverrides(), 3ul) << "Pop 3/3 override counter (" << r0->getOverrides() << ") not 3";
+    EXPECT_EQ(r0->getTimeStamp(), ts2) << "Pop 3/3 timestamp is not as from 3rd added Update";
+    EXPECT_EQ(r0->getStatus(), 112) << "Pop 3/3 status is not as from 3rd added Update";
+}
+
+TEST_F(RingUpdateQueueTest, pushUpdate_EmptyQueue_wasFirstIsCorrect) {
+    epicsTime ts0;
+    ts0.getCurrent();
+    std::shared_ptr<TestUpdate> u0(new TestUpdate(ts0, ProcessReason::incomingData, 0, 100));
+    epicsTime ts1 = ts0 + 1.0;
+    std::shared_ptr<TestUpdate> u1(new TestUpdate(ts1, ProcessReason::writeComplete, 1, 100));
+    bool wasFirst = false;
+
+    q0.pushUpdate(u0, &wasFirst);
+    EXPECT_EQ(wasFirst, true) << "First push does not set wasFirst = true";
+    q0.pushUpdate(u1, &wasFirst);
+    EXPECT_EQ(wasFirst, false) << "Second push does not set wasFirst = false";
+}
+
+TEST_F(RingUpdateQueueTest, statistics_DroppedAndHighWaterMark) {
+    EXPECT_EQ(q0.highWaterMark(), 0lu) << "Empty queue has high water mark " << q0.highWaterMark();
+    EXPECT_EQ(q1.highWaterMark(), 3lu) << "Full queue has high water mark " << q1.highWaterMark() << " not 3";
+    EXPECT_EQ(q1.noOfDropped(), 0lu) << "Queue without overflow has dropped updates";
+
+    q1.pushUpdate(std::make_shared<TestUpdate>(ts00, ProcessReason::incomingData, 3, 103));
+    q2.pushUpdate(std::make_shared<TestUpdate>(ts00, ProcessReason::incomingData, 3, 103));
+    q2.pushUpdate(std::make_shared<TestUpdate>(ts00, ProcessReason::incomingData, 4, 104));
+    EXPECT_EQ(q1.noOfDropped(), 1lu) << "Discard oldest: dropped updates (" << q1.noOfDropped() << ") not 1";
+    EXPECT_EQ(q2.noOfDropped(), 2lu) << "Discard newest: dropped updates (" << q2.noOfDropped() << ") not 2";
+    EXPECT_EQ(q1.highWaterMark(), 3lu) << "High water mark exceeds capacity";
+
+    q1.popUpdate();
+    q1.resetStats();
+    EXPECT_EQ(q1.noOfDropped(), 0lu) << "Reset does not clear dropped updates";
+    EXPECT_EQ(q1.highWaterMark(), 2lu) << "Reset does not set high water mark to current size";
+
+    RingUpdateQueue<TestUpdate> q(1ul);
+    q.pushUpdate(std::make_shared<TestUpdate>(ts00, ProcessReason::incomingData, 0, 100));
+    q.pushUpdate(std::make_shared<TestUpdate>(ts00, ProcessReason::incomingData, 1, 101));
+    EXPECT_EQ(q.noOfDropped(), 1lu) << "Conflating: dropped updates (" << q.noOfDropped() << ") not 1";
+    EXPECT_EQ(q.highWaterMark(), 1lu) << "Conflating: high water mark not 1";
+}
+
+TEST(RingUpdateQueueMaxAgeTest, popUpdate_DropsStaleDataKeepsEvents) {
+    RingUpdateQueue<TestUpdate> q(10ul, true, 0.05);
+    epicsTime ts0;
+    ts0.getCurrent();
+    ProcessReason nReason;
+
+    EXPECT_EQ(q.getMaxAge(), 0.05) << "Max age parameter wrong";
+    for (int i = 0; i < 3; i++)
+        q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::incomingData, i, 100));
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::connectionLoss));
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::incomingData, 4, 100));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::incomingData, 5, 100));
+
+    std::shared_ptr<TestUpdate> r0 = q.popUpdate(&nReason);
+    EXPECT_EQ(r0->getType(), ProcessReason::connectionLoss) << "Stale data not dropped up to connection loss";
+    EXPECT_EQ(r0->getOverrides(), 3ul) << "Expired updates (" << r0->getOverrides() << ") not counted as 3 overrides";
+    EXPECT_EQ(nReason, ProcessReason::incomingData) << "nextReason after connection loss is not incomingData";
+
+    r0 = q.popUpdate(&nReason);
+    EXPECT_EQ(r0->getData(), 5) << "Stale data not dropped in favour of fresh data";
+    EXPECT_EQ(r0->getOverrides(), 1ul) << "Override counter (" << r0->getOverrides() << ") not 1";
+    EXPECT_EQ(nReason, ProcessReason::none) << "nextReason for empty queue is not none";
+    EXPECT_EQ(q.noOfExpired(), 4lu) << "Expired updates (" << q.noOfExpired() << ") not 4";
+
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::incomingData, 6, 100));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    r0 = q.popUpdate();
+    EXPECT_EQ(r0->getData(), 6) << "Stale data without newer update not returned";
+}
+
+TEST(RingUpdateQueueAdaptiveTest, resize_GrowsOnOverflowShrinksWhenQuiet) {
+    RingUpdateQueue<TestUpdate> q(4ul);
+    epicsTime ts0;
+    ts0.getCurrent();
+    q.setAdaptive(2, 16);
+
+    // Bursts of 10 overflow the queue, which grows up to 16 elements
+    for (int burst = 0; burst < 4; burst++) {
+        for (int i = 0; i < 10; i++)
+            q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::incomingData, i, 100));
+        while (!q.empty())
+            q.popUpdate();
+    }
+    EXPECT_EQ(q.capacity(), 16lu) << "Queue did not grow to upper bound (capacity " << q.capacity() << ")";
+    unsigned long dropped = q.noOfDropped();
+    for (int i = 0; i < 10; i++)
+        q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::incomingData, i, 100));
+    EXPECT_EQ(q.noOfDropped(), dropped) << "Grown queue still drops updates";
+
+    // Keeping order and data while resizing
+    int last = -1;
+    bool ordered = true;
+    while (!q.empty()) {
+        std::shared_ptr<TestUpdate> r = q.popUpdate();
+        if (r->getData() <= last) ordered = false;
+        last = r->getData();
+    }
+    EXPECT_TRUE(ordered) << "Updates out of order after resize";
+
+    // Single updates: the queue shrinks down to the lower bound
+    for (int i = 0; i < 1000; i++) {
+        q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::incomingData, i, 100));
+        q.popUpdate();
+    }
+    EXPECT_EQ(q.capacity(), 2lu) << "Queue did not shrink to lower bound (capacity " << q.capacity() << ")";
+    EXPECT_GE(q.noOfResizes(), 4lu) << "Resizes not counted";
+}
+
+TEST(RingUpdateQueueAdaptiveTest, budget_LimitsGrowth) {
+    const size_t before = ClientQueueBudget::inUse();
+    {
+        RingUpdateQueue<TestUpdate> q(4ul);
+        epicsTime ts0;
+        ts0.getCurrent();
+        EXPECT_GT(ClientQueueBudget::inUse(), before) << "Queue memory not accounted";
+        ClientQueueBudget::setLimit(ClientQueueBudget::inUse());
+        q.setAdaptive(2, 16);
+        for (int i = 0; i < 10; i++)
+            q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::incomingData, i, 100));
+        while (!q.empty())
+            q.popUpdate();
+        EXPECT_EQ(q.capacity(), 4lu) << "Queue grew beyond memory budget";
+        ClientQueueBudget::setLimit(0);
+    }
+    EXPECT_EQ(ClientQueueBudget::inUse(), before) << "Queue memory not released";
+}
+
+TEST(RingUpdateQueueDrainTest, popDrained_MergesDataStopsAtEvents) {
+    RingUpdateQueue<TestUpdate> q(10ul);
+    epicsTime ts0;
+    ts0.getCurrent();
+    ProcessReason nReason;
+
+    for (int i = 0; i < 4; i++)
+        q.pushUpdate(std::make_shared<TestUpdate>(ts0 + i, ProcessReason::incomingData, i, 100));
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0 + 4.0, ProcessReason::connectionLoss));
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0 + 5.0, ProcessReason::incomingData, 5, 100));
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0 + 6.0, ProcessReason::incomingData, 6, 100));
+
+    std::shared_ptr<TestUpdate> r0 = q.popDrained(&nReason);
+    EXPECT_EQ(r0->getData(), 3) << "Drain did not return newest data update";
+    EXPECT_EQ(r0->getOverrides(), 3ul) << "Drained updates (" << r0->getOverrides() << ") not counted as 3 overrides";
+    EXPECT_EQ(nReason, ProcessReason::connectionLoss) << "Drain did not stop at connection loss";
+    EXPECT_EQ(q.size(), 3lu) << "After drain, update queue returns size " << q.size() << " not 3";
+
+    r0 = q.popDrained(&nReason);
+    EXPECT_EQ(r0->getType(), ProcessReason::connectionLoss) << "Drain did not return connection loss";
+    EXPECT_EQ(r0->getOverrides(), 0ul) << "Connection loss has overrides";
+    EXPECT_EQ(nReason, ProcessReason::incomingData) << "nextReason after connection loss is not incomingData";
+
+    r0 = q.popDrained(&nReason);
+    EXPECT_EQ(r0->getData(), 6) << "Second drain did not return newest data update";
+    EXPECT_EQ(r0->getOverrides(), 1ul) << "Second drain override counter (" << r0->getOverrides() << ") not 1";
+    EXPECT_EQ(nReason, ProcessReason::none) << "nextReason for empty queue is not none";
+}
+
+TEST(RingUpdateQueueConflatingTest, pushUpdate_KeepsLatestCountsOverrides) {
+    RingUpdateQueue<TestUpdate> q(1ul);
+    epicsTime ts0;
+    ts0.getCurrent();
+    bool wasFirst = false;
+    ProcessReason nReason;
+
+    EXPECT_EQ(q.capacity(), 1lu) << "Conflating queue returns capacity " << q.capacity() << " not 1";
+    EXPECT_EQ(q.empty(), true) << "Conflating queue not empty after creation";
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::incomingData, 0, 100), &wasFirst);
+    EXPECT_EQ(wasFirst, true) << "First push does not set wasFirst = true";
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0 + 1.0, ProcessReason::readComplete, 1, 101), &wasFirst);
+    EXPECT_EQ(wasFirst, false) << "Second push does not set wasFirst = false";
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0 + 2.0, ProcessReason::incomingData, 2, 102));
+    EXPECT_EQ(q.size(), 1lu) << "Conflating queue returns size " << q.size() << " not 1";
+
+    std::shared_ptr<TestUpdate> r0 = q.popUpdate(&nReason);
+    EXPECT_EQ(q.empty(), true) << "Conflating queue not empty after pop";
+    EXPECT_EQ(nReason, ProcessReason::none) << "nextReason for empty queue is not none";
+    EXPECT_EQ(r0->getData(), 2) << "Pop did not return latest update";
+    EXPECT_EQ(r0->getOverrides(), 2ul) << "Override counter (" << r0->getOverrides() << ") not 2";
+    EXPECT_EQ(r0->getTimeStamp(), ts0 + 2.0) << "Timestamp is not from latest update";
+
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::connectionLoss), &wasFirst);
+    EXPECT_EQ(wasFirst, true) << "Push after pop does not set wasFirst = true";
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::writeComplete, 3, 0));
+    r0 = q.popUpdate();
+    EXPECT_EQ(r0->getType(), ProcessReason::writeComplete) << "Pop did not return latest update type";
+    EXPECT_EQ(r0->getOverrides(), 1ul) << "Override counter (" << r0->getOverrides() << ") not 1";
+
+    q.pushUpdate(std::make_shared<TestUpdate>(ts0, ProcessReason::readFailure));
+    r0 = q.popUpdate();
+    EXPECT_EQ(r0->getOverrides(), 0ul) << "Override counter not reset for next update";
+}
+
+TEST(RingUpdateQueueConcurrentTest, conflating_NoUpdateLostOrDuplicated) {
+    const unsigned int noOfUpdates = 200000;
+    RingUpdateQueue<TestUpdate> q(1ul);
+    epicsTime ts;
+    unsigned long received = 0;
+    unsigned long overrides = 0;
+    int last = -1;
+    bool ordered = true;
+    std::atomic<bool> done(false);
+
+    std::thread consumer([&]() {
+        for (;;) {
+            if (q.empty()) {
+                if (done && q.empty()) break;
+                std::this_thread::yield();
+                continue;
+            }
+            std::shared_ptr<TestUpdate> r = q.popUpdate();
+            if (r->getData() <= last) ordered = false;
+            last = r->getData();
+            overrides += r->getOverrides();
+            received++;
+        }
+    });
+    for (unsigned int i = 0; i < noOfUpdates; i++)
+        q.pushUpdate(std::make_shared<TestUpdate>(ts, ProcessReason::incomingData, static_cast<int>(i), 0));
+    done = true;
+    consumer.join();
+
+    EXPECT_TRUE(ordered) << "Updates received out of order";
+    EXPECT_EQ(last, static_cast<int>(noOfUpdates - 1)) << "Last update not received";
+    EXPECT_LE(received + overrides, noOfUpdates) << "Updates duplicated";
+}
+
+TEST(RingUpdateQueueConcurrentTest, conflatingTwoProducers_NoUpdateLostOrDuplicated) {
+    const int noOfUpdates = 100000; // per producer
+    RingUpdateQueue<TestUpdate> q(1ul);
+    epicsTime ts;
+    unsigned long received = 0;
+    unsigned long overrides = 0;
+    int last[2] = { -1, -1 };
+    bool ordered = true;
+    bool valid = true;
+    std::atomic<int> running(2);
+
+    std::thread consumer([&]() {
+        for (;;) {
+            if (q.empty()) {
+                if (!running && q.empty()) break;
+                std::this_thread::yield();
+                continue;
+            }
+            std::shared_ptr<TestUpdate> r = q.popUpdate();
+            const int p = r->getData() / noOfUpdates;
+            const int i = r->getData() % noOfUpdates;
+            const ProcessReason type = p ? ProcessReason::readComplete : ProcessReason::incomingData;
+            if (p < 0 || p > 1 || r->getType() != type) {
+                valid = false;
+                continue;
+            }
+            if (i <= last[p]) ordered = false;
+            last[p] = i;
+            overrides += r->getOverrides();
+            received++;
+        }
+    });
+    auto producer = [&](const int p, const ProcessReason type) {
+        for (int i = 0; i < noOfUpdates; i++)
+            q.pushUpdate(std::make_shared<TestUpdate>(ts, type, p * noOfUpdates + i, 0));
+        running--;
+    };
+    std::thread data(producer, 0, ProcessReason::incomingData);
+    std::thread reads(producer, 1, ProcessReason::readComplete);
+    data.join();
+    reads.join();
+    consumer.join();
+
+    EXPECT_TRUE(valid) << "Corrupted update received";
+    EXPECT_TRUE(ordered) << "Updates of a producer received out of order";
+    EXPECT_TRUE(last[0] == noOfUpdates - 1 || last[1] == noOfUpdates - 1) << "Last update not received";
+    EXPECT_LE(received + overrides, 2ul * noOfUpdates) << "Updates duplicated";
+    EXPECT_TRUE(q.empty()) << "Update left in queue";
+}
+
+TEST(RingUpdateQueueConcurrentTest, adaptive_NoUpdateLostOrDuplicated) {
+    const unsigned int noOfUpdates = 200000;
+    RingUpdateQueue<TestUpdate> q(4ul);
+    q.setAdaptive(2, 64);
+    epicsTime ts;
+    unsigned long received = 0;
+    unsigned long overrides = 0;
+    int last = -1;
+    bool ordered = true;
+    std::atomic<bool> done(false);
+
+    std::thread consumer([&]() {
+        for (;;) {
+            if (q.empty()) {
+                if (done && q.empty()) break;
+                std::this_thread::yield();
+                continue;
+            }
+            std::shared_ptr<TestUpdate> r = q.popUpdate();
+            if (r->getData() <= last) ordered = false;
+            last = r->getData();
+            overrides += r->getOverrides();
+            received++;
+        }
+    });
+    for (unsigned int i = 0; i < noOfUpdates; i++)
+        q.pushUpdate(std::make_shared<TestUpdate>(ts, ProcessReason::incomingData, static_cast<int>(i), 0));
+    done = true;
+    consumer.join();
+
+    EXPECT_TRUE(ordered) << "Updates received out of order";
+    EXPECT_EQ(received + overrides, noOfUpdates) << "Updates lost (not counted as overrides)";
+    EXPECT_EQ(last, static_cast<int>(noOfUpdates - 1)) << "Last update not received";
+}
+
+TEST(RingUpdateQueueConcurrentTest, producerConsumer_NoUpdateLostOrDuplicated) {
+    const unsigned int noOfUpdates = 200000;
+    RingUpdateQueue<TestUpdate> q(4ul);
+    epicsTime ts;
+    unsigned long received = 0;
+    unsigned long overrides = 0;
+    int last = -1;
+    bool ordered = true;
+    std::atomic<bool> done(false);
+
+    std::thread consumer([&]() {
+        for (;;) {
+            if (q.empty()) {
+                if (done && q.empty()) break;
+                std::this_thread::yield();
+                continue;
+            }
+            std::shared_ptr<TestUpdate> r = q.popUpdate();
+            if (r->getData() <= last) ordered = false;
+            last = r->getData();
+            overrides += r->getOverrides();
+            received++;
+        }
+    });
+    for (unsigned int i = 0; i < noOfUpdates; i++)
+        q.pushUpdate(std::make_shared<TestUpdate>(ts, ProcessReason::incomingData, static_cast<int>(i), 0));
+    done = true;
+    consumer.join();
+
+    EXPECT_TRUE(ordered) << "Updates received out of order";
+    EXPECT_EQ(received + overrides, noOfUpdates) << "Updates lost (not counted as overrides)";
+    EXPECT_EQ(last, static_cast<int>(noOfUpdates - 1)) << "Last update not received";
+}
+
+} // namespace
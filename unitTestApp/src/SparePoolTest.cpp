@@ -0,0 +1,89 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "SparePool.h"
+
+namespace {
+
+using namespace DevOpcua;
+
+TEST(SparePoolTest, capacity_RoundedUpToPowerOf2) {
+    SparePool<int *> p5(5), p8(8), p1(1);
+    EXPECT_EQ(p5.capacity(), 8u) << "capacity not rounded up";
+    EXPECT_EQ(p8.capacity(), 8u) << "power of 2 capacity changed";
+    EXPECT_EQ(p1.capacity(), 2u) << "minimal capacity wrong";
+}
+
+TEST(SparePoolTest, putGet_FifoBoundedByCapacity) {
+    int v[5];
+    SparePool<int *> pool(4);
+    EXPECT_EQ(pool.get(), nullptr) << "empty pool returns a spare";
+
+    for (int i = 0; i < 4; i++)
+        EXPECT_TRUE(pool.put(&v[i])) << "spare " << i << " not added";
+    EXPECT_FALSE(pool.put(&v[4])) << "spare added to full pool";
+    EXPECT_EQ(pool.size(), 4u) << "wrong number of spares";
+
+    for (int i = 0; i < 4; i++)
+        EXPECT_EQ(pool.get(), &v[i]) << "spares not returned in order";
+    EXPECT_EQ(pool.get(), nullptr) << "drained pool returns a spare";
+    EXPECT_EQ(pool.size(), 0u) << "wrong number of spares";
+
+    // wrap around
+    for (int round = 0; round < 10; round++) {
+        EXPECT_TRUE(pool.put(&v[round % 5])) << "spare not added in round " << round;
+        EXPECT_EQ(pool.get(), &v[round % 5]) << "wrong spare in round " << round;
+    }
+}
+
+TEST(SparePoolTest, concurrentPutGet_NoSpareLostOrDuplicated) {
+    const int noOfThreads = 4;
+    const int spares = 64;
+    const int rounds = 100000;
+    std::vector<int> v(spares, 0);
+    SparePool<int *> pool(spares);
+    for (auto &i : v)
+        pool.put(&i);
+
+    // every thread takes a spare, increments it, and returns it
+    // (close to full, put() may reject a spare while another thread is taking one)
+    std::atomic<int> misses(0), rejected(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < noOfThreads; t++) {
+        threads.emplace_back([&]() {
+            for (int r = 0; r < rounds; r++) {
+                int *p = pool.get();
+                if (!p) {
+                    misses++;
+                    continue;
+                }
+                (*p)++;
+                if (!pool.put(p))
+                    rejected++;
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    EXPECT_EQ(pool.size() + rejected, static_cast<size_t>(spares)) << "spares lost";
+    long total = 0;
+    for (auto i : v)
+        total += i;
+    EXPECT_EQ(total + misses, noOfThreads * rounds) << "spare used by two threads at a time";
+}
+
+} // namespace
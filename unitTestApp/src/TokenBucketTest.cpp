@@ -0,0 +1,54 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <gtest/gtest.h>
+
+#include <epicsThread.h>
+
+#include "devOpcua.h"
+#include "TokenBucket.h"
+
+namespace {
+
+using namespace DevOpcua;
+
+TEST(TokenBucketTest, rate0_NeverWaits) {
+    TokenBucket tb;
+    EXPECT_EQ(tb.rate(), 0.0) << "bucket not created disabled";
+    EXPECT_EQ(tb.take(1e6), 0.0) << "disabled bucket requests a wait";
+    EXPECT_EQ(tb.noOfTakes(), 0lu) << "disabled bucket counts takes";
+}
+
+TEST(TokenBucketTest, burstThenDebt_WaitsProportionalToDebt) {
+    TokenBucket tb;
+    tb.setRate(100.0, 10.0);
+    EXPECT_EQ(tb.rate(), 100.0) << "rate parameter wrong";
+
+    EXPECT_EQ(tb.take(10.0), 0.0) << "full bucket requests a wait";
+    EXPECT_NEAR(tb.take(50.0), 0.5, 0.02) << "wait for 50 tokens of debt wrong";
+    EXPECT_NEAR(tb.take(10.0), 0.6, 0.02) << "debt not accumulated";
+    EXPECT_EQ(tb.noOfTakes(), 3lu) << "wrong number of takes";
+    EXPECT_EQ(tb.noOfThrottled(), 2lu) << "wrong number of throttled takes";
+    EXPECT_NEAR(tb.throttledSeconds(), 1.1, 0.04) << "wrong accumulated wait time";
+
+    tb.resetStats();
+    EXPECT_EQ(tb.noOfThrottled(), 0lu) << "statistics not reset";
+}
+
+TEST(TokenBucketTest, refill_TokensAddedAtRateUpToBurst) {
+    TokenBucket tb;
+    tb.setRate(100.0, 5.0);
+    EXPECT_EQ(tb.take(5.0), 0.0) << "full bucket requests a wait";
+    epicsThread::sleep(0.2); // refills 20 tokens, capped at burst size 5
+    EXPECT_EQ(tb.take(5.0), 0.0) << "bucket not refilled";
+    EXPECT_GT(tb.take(1.0), 0.0) << "bucket filled beyond burst size";
+}
+
+} // namespace
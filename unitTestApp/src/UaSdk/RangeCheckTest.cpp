@@ -606,4 +606,61 @@ TEST(RangeCheckTest, ToDouble) {
     EXPECT_TRUE(isWithinRange<OpcUa_Double>(static_cast<epicsFloat64>(DBL_MAX))) << "Double<-Float64: DBL_MAX (large positive) not detected as out of range";
 }
 
+// Array writes: range check of all elements, reporting the first element out of range
+
+TEST(RangeCheckTest, ArrayToSByte) {
+    const epicsInt32 i32[] = { -128, 0, 127, 128, -129 };
+    OpcUa_SByte sb[5];
+    EXPECT_EQ(convertArrayChecked(sb, i32, 3), 3u) << "SByte<-Int32: -128..127 detected as out of range";
+    EXPECT_EQ(convertArrayChecked(sb, i32, 5), 3u) << "SByte<-Int32: 128 not detected as first out of range element";
+
+    const epicsUInt16 u16[] = { 0, 127, 128 };
+    EXPECT_EQ(convertArrayChecked(sb, u16, 3), 2u) << "SByte<-UInt16: 128 not detected as out of range";
+
+    const epicsFloat64 d[] = { -128.0, 127.0, -0.0, -129.0 };
+    EXPECT_EQ(convertArrayChecked(sb, d, 4), 3u) << "SByte<-Float64: -129. not detected as out of range";
+}
+
+TEST(RangeCheckTest, ArrayToUInt32) {
+    const epicsInt64 i64[] = { 0, 4294967295ll, 4294967296ll };
+    OpcUa_UInt32 u32[3];
+    EXPECT_EQ(convertArrayChecked(u32, i64, 3), 2u) << "UInt32<-Int64: 2^32 not detected as out of range";
+
+    const epicsInt32 i32[] = { 5, -1 };
+    EXPECT_EQ(convertArrayChecked(u32, i32, 2), 1u) << "UInt32<-Int32: -1 not detected as out of range";
+
+    const epicsFloat32 f[] = { 0.f, 4294967040.f, 4294967296.f };
+    EXPECT_EQ(convertArrayChecked(u32, f, 3), 2u) << "UInt32<-Float32: 2^32 not detected as out of range";
+}
+
+TEST(RangeCheckTest, ArrayToFloat) {
+    const epicsFloat64 d[] = { -FLT_MAX, 0., FLT_MAX, DBL_MAX };
+    OpcUa_Float f[4];
+    EXPECT_EQ(convertArrayChecked(f, d, 3), 3u) << "Float<-Float64: -FLT_MAX..FLT_MAX detected as out of range";
+    EXPECT_EQ(f[2], FLT_MAX) << "Float<-Float64: FLT_MAX wrong value";
+    EXPECT_EQ(convertArrayChecked(f, d, 4), 3u) << "Float<-Float64: DBL_MAX not detected as out of range";
+
+    const epicsUInt64 u64[] = { 0, 18446744073709551615ull };
+    EXPECT_EQ(convertArrayChecked(f, u64, 2), 2u) << "Float<-UInt64: MAX (2^64-1) detected as out of range";
+}
+
+TEST(RangeCheckTest, ArrayToVariant) {
+    const epicsFloat64 d[] = { 1.5, -2.0, 300.0 };
+    OpcUa_Variant v;
+    epicsUInt32 bad = 0;
+
+    EXPECT_TRUE(arrayToVariant(v, OpcUaType_Int16, d, 3, bad)) << "Int16<-Float64: array not converted";
+    EXPECT_EQ(bad, 3u) << "Int16<-Float64: element detected as out of range";
+    UaVariant var;
+    var.attach(&v);
+    EXPECT_EQ(var.type(), OpcUaType_Int16) << "Int16<-Float64: wrong variant type";
+    EXPECT_EQ(var.arraySize(), 3) << "Int16<-Float64: wrong array size";
+    EXPECT_EQ(v.Value.Array.Value.Int16Array[2], 300) << "Int16<-Float64: wrong value";
+
+    EXPECT_TRUE(arrayToVariant(v, OpcUaType_Byte, d, 3, bad)) << "Byte<-Float64: array not converted";
+    EXPECT_EQ(bad, 1u) << "Byte<-Float64: -2. not detected as first out of range element";
+
+    EXPECT_FALSE(arrayToVariant(v, OpcUaType_String, d, 3, bad)) << "String<-Float64: array converted";
+}
+
 } // namespace
@@ -0,0 +1,125 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <gtest/gtest.h>
+
+#include <epicsTypes.h>
+
+#include "DataElementUaSdk.h"
+
+namespace {
+
+using namespace DevOpcua;
+
+TEST(ScalarConversionTest, Lossless_WideningOnly) {
+    OpcUa_Int32 i32;
+    OpcUa_UInt32 u32;
+    OpcUa_Int64 i64;
+    OpcUa_Double d;
+
+    EXPECT_TRUE(losslessTo(static_cast<OpcUa_Int16>(-3), i32)) << "Int32<-Int16 not lossless";
+    EXPECT_EQ(i32, -3) << "Int32<-Int16 wrong value";
+    EXPECT_TRUE(losslessTo(static_cast<OpcUa_UInt32>(5), i64)) << "Int64<-UInt32 not lossless";
+    EXPECT_TRUE(losslessTo(static_cast<OpcUa_Int32>(-7), d)) << "Double<-Int32 not lossless";
+    EXPECT_TRUE(losslessTo(static_cast<OpcUa_Float>(1.5), d)) << "Double<-Float not lossless";
+    EXPECT_EQ(d, 1.5) << "Double<-Float wrong value";
+
+    EXPECT_FALSE(losslessTo(static_cast<OpcUa_UInt32>(3), i32)) << "Int32<-UInt32 taken as lossless";
+    EXPECT_FALSE(losslessTo(static_cast<OpcUa_Int32>(3), u32)) << "UInt32<-Int32 taken as lossless";
+    EXPECT_FALSE(losslessTo(static_cast<OpcUa_Int64>(3), d)) << "Double<-Int64 taken as lossless";
+    EXPECT_FALSE(losslessTo(static_cast<OpcUa_Double>(1.0), i64)) << "Int64<-Double taken as lossless";
+}
+
+TEST(ScalarConversionTest, FromVariant_BuiltInScalars) {
+    UaVariant v;
+    OpcUa_Int32 i32;
+    OpcUa_Double d;
+
+    v.setInt32(-42);
+    EXPECT_TRUE(scalarFromVariant(*static_cast<const OpcUa_Variant *>(v), i32)) << "Int32 not converted directly";
+    EXPECT_EQ(i32, -42) << "Int32 wrong value";
+
+    v.setBool(OpcUa_True);
+    EXPECT_TRUE(scalarFromVariant(*static_cast<const OpcUa_Variant *>(v), d)) << "Boolean not converted directly";
+    EXPECT_EQ(d, 1.0) << "Boolean wrong value";
+
+    v.setDouble(2.5);
+    EXPECT_FALSE(scalarFromVariant(*static_cast<const OpcUa_Variant *>(v), i32)) << "Int32<-Double converted directly";
+
+    v.setString("12");
+    EXPECT_FALSE(scalarFromVariant(*static_cast<const OpcUa_Variant *>(v), i32)) << "String converted directly";
+}
+
+TEST(ScalarConversionTest, Converters_ResolvedPerType) {
+    UaVariant v;
+    OpcUa_Int32 i32 = 0;
+
+    v.setInt16(-5);
+    ScalarReader<OpcUa_Int32>::Reader read = ScalarReader<OpcUa_Int32>::resolve(OpcUaType_Int16);
+    ASSERT_NE(read, nullptr) << "no reader for Int32<-Int16";
+    EXPECT_TRUE(read(*static_cast<const OpcUa_Variant *>(v), i32)) << "Int32<-Int16 not read";
+    EXPECT_EQ(i32, -5) << "Int32<-Int16 wrong value";
+    EXPECT_EQ(ScalarReader<OpcUa_Int32>::resolve(OpcUaType_Double), nullptr) << "direct reader for Int32<-Double";
+    EXPECT_EQ(ScalarReader<OpcUa_Int32>::resolve(OpcUaType_String), nullptr) << "direct reader for Int32<-String";
+
+    ScalarWriter<epicsInt32>::Writer write = ScalarWriter<epicsInt32>::resolve(OpcUaType_Byte);
+    ASSERT_NE(write, nullptr) << "no writer for Byte<-epicsInt32";
+    EXPECT_TRUE(write(v, 200)) << "Byte<-epicsInt32: 200 not written";
+    EXPECT_EQ(v.type(), OpcUaType_Byte) << "Byte<-epicsInt32 wrong type";
+    EXPECT_FALSE(write(v, 256)) << "Byte<-epicsInt32: 256 written";
+    OpcUa_Byte b = 0;
+    v.toByte(b);
+    EXPECT_EQ(b, 200) << "Byte<-epicsInt32: out of range value changed the variant";
+    EXPECT_EQ(ScalarWriter<epicsInt32>::resolve(OpcUaType_ExtensionObject), nullptr) << "writer for ExtensionObject";
+}
+
+int noOfResolves = 0;
+int *resolveCounted (const OpcUa_BuiltInType) { noOfResolves++; return &noOfResolves; }
+
+TEST(ScalarConversionTest, CachedConverter_ResolvesOnTypeChangeOnly) {
+    CachedConverter<int *> cache;
+    noOfResolves = 0;
+    cache.get(OpcUaType_Int32, &resolveCounted);
+    cache.get(OpcUaType_Int32, &resolveCounted);
+    EXPECT_EQ(noOfResolves, 1) << "converter resolved again for the same type";
+    cache.get(OpcUaType_Double, &resolveCounted);
+    EXPECT_EQ(noOfResolves, 2) << "converter not resolved again after type change";
+    EXPECT_EQ(cache.type, OpcUaType_Double) << "wrong cached type";
+}
+
+TEST(ScalarConversionTest, ArrayFromVariant_ConvertsAndSaturates) {
+    UaVariant v;
+    UaInt16Array i16;
+    i16.create(3);
+    i16[0] = -300;
+    i16[1] = 7;
+    i16[2] = 300;
+    v.setInt16Array(i16);
+    epicsFloat64 d[4];
+    epicsUInt8 u8[4];
+    epicsUInt32 n = 0;
+    bool clipped = true;
+
+    EXPECT_TRUE(arrayFromVariant(*static_cast<const OpcUa_Variant *>(v), d, 4, n, clipped)) << "Double<-Int16 array not converted";
+    EXPECT_EQ(n, 3u) << "Double<-Int16 wrong number of elements";
+    EXPECT_FALSE(clipped) << "Double<-Int16 reports elements out of range";
+    EXPECT_EQ(d[0], -300.0) << "Double<-Int16 wrong value";
+
+    EXPECT_TRUE(arrayFromVariant(*static_cast<const OpcUa_Variant *>(v), u8, 2, n, clipped)) << "UInt8<-Int16 array not converted";
+    EXPECT_EQ(n, 2u) << "UInt8<-Int16 not limited to target size";
+    EXPECT_TRUE(clipped) << "UInt8<-Int16 does not report elements out of range";
+    EXPECT_EQ(u8[0], 0u) << "UInt8<-Int16 not saturated";
+    EXPECT_EQ(u8[1], 7u) << "UInt8<-Int16 wrong value";
+
+    v.setInt16(3);
+    EXPECT_FALSE(arrayFromVariant(*static_cast<const OpcUa_Variant *>(v), d, 4, n, clipped)) << "scalar converted as array";
+}
+
+} // namespace
@@ -0,0 +1,89 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <gtest/gtest.h>
+
+#include <epicsTypes.h>
+
+#include "DataElementUaSdk.h"
+
+// Microbenchmark for the scalar conversions of the data elements:
+// type switch on every call vs. converter resolved once and cached,
+// with the SDK conversion (UaVariant::toXxx) as reference.
+// Not run as part of the regular test suite - results are printed on stdout.
+
+namespace {
+
+using namespace DevOpcua;
+
+const unsigned int callsPerRun = 10000000;
+
+template<typename F>
+double
+nsPerCall(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < callsPerRun; i++)
+        f(i);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() * 1e9 / callsPerRun;
+}
+
+void
+printRow(const std::string &what, const double ns)
+{
+    std::cout << std::setw(34) << what
+              << std::setw(12) << std::fixed << std::setprecision(2) << ns << std::endl;
+}
+
+TEST(ScalarConverterBenchmark, read_SwitchVsCached) {
+    UaVariant v;
+    v.setInt16(42);
+    const OpcUa_Variant *raw = v;
+    volatile OpcUa_Int32 sink;
+    CachedConverter<ScalarReader<OpcUa_Int32>::Reader> cache;
+
+    std::cout << std::setw(34) << "read Int32<-Int16" << std::setw(12) << "[ns/call]" << std::endl;
+    printRow("SDK UaVariant::toInt32", nsPerCall([&](unsigned int) {
+        OpcUa_Int32 x;
+        v.toInt32(x);
+        sink = x;
+    }));
+    printRow("type switch per call", nsPerCall([&](unsigned int) {
+        OpcUa_Int32 x;
+        scalarFromVariant(*raw, x);
+        sink = x;
+    }));
+    printRow("cached reader", nsPerCall([&](unsigned int) {
+        OpcUa_Int32 x;
+        cache.get(static_cast<OpcUa_BuiltInType>(raw->Datatype), &ScalarReader<OpcUa_Int32>::resolve)(*raw, x);
+        sink = x;
+    }));
+    EXPECT_EQ(sink, 42) << "wrong value read";
+}
+
+TEST(ScalarConverterBenchmark, write_SwitchVsCached) {
+    UaVariant v;
+    CachedConverter<ScalarWriter<epicsFloat64>::Writer> cache;
+
+    std::cout << std::setw(34) << "write Float<-epicsFloat64" << std::setw(12) << "[ns/call]" << std::endl;
+    printRow("type switch per call", nsPerCall([&](unsigned int i) {
+        ScalarWriter<epicsFloat64>::resolve(OpcUaType_Float)(v, static_cast<epicsFloat64>(i));
+    }));
+    printRow("cached writer", nsPerCall([&](unsigned int i) {
+        cache.get(OpcUaType_Float, &ScalarWriter<epicsFloat64>::resolve)(v, static_cast<epicsFloat64>(i));
+    }));
+    EXPECT_EQ(v.type(), OpcUaType_Float) << "wrong type written";
+}
+
+} // namespace
@@ -0,0 +1,89 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <epicsTime.h>
+
+#include "devOpcua.h"
+#include "Update.h"
+#include "UpdatePool.h"
+#include "RingUpdateQueue.h"
+
+namespace {
+
+using namespace DevOpcua;
+
+typedef Update<std::string, int> TestUpdate;
+
+TEST(UpdatePoolTest, blocks_AreReused) {
+    BlockPool pool(4);
+    EXPECT_EQ(pool.blockSize(), 0u) << "block size set before first allocation";
+
+    void *p0 = pool.allocate(40);
+    EXPECT_EQ(pool.blockSize(), 40u) << "block size not set by first allocation";
+    pool.deallocate(p0, 40);
+    EXPECT_EQ(pool.spareBlocks(), 1u) << "freed block not kept as spare";
+
+    void *p1 = pool.allocate(32);
+    EXPECT_EQ(p1, p0) << "spare block not reused";
+    EXPECT_EQ(pool.noOfHeapAllocations(), 1lu) << "wrong number of heap allocations";
+    pool.deallocate(p1, 32);
+}
+
+TEST(UpdatePoolTest, oversizeAndOverflow_GoToHeap) {
+    BlockPool pool(2);
+    std::vector<void *> blocks;
+    for (int i = 0; i < 4; i++)
+        blocks.push_back(pool.allocate(16));
+    void *big = pool.allocate(64);
+    EXPECT_EQ(pool.noOfHeapAllocations(), 5lu) << "wrong number of heap allocations";
+    pool.deallocate(big, 64);
+    EXPECT_EQ(pool.spareBlocks(), 0u) << "oversize block kept as spare";
+    for (auto p : blocks)
+        pool.deallocate(p, 16);
+    EXPECT_EQ(pool.spareBlocks(), 2u) << "spare blocks not limited to pool capacity";
+}
+
+TEST(UpdatePoolTest, allocateShared_SteadyStateWithoutHeap) {
+    BlockPool pool(8);
+    RingUpdateQueue<TestUpdate> q(5);
+    epicsTime ts = epicsTime::getCurrent();
+
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 5; i++)
+            q.pushUpdate(std::allocate_shared<TestUpdate>(PoolAllocator<TestUpdate>(pool),
+                                                          ts, ProcessReason::incomingData, std::string("x"), i));
+        q.pushUpdate(std::allocate_shared<TestUpdate>(PoolAllocator<TestUpdate>(pool),
+                                                      ts, ProcessReason::connectionLoss));
+        while (!q.empty())
+            q.popUpdate();
+    }
+    EXPECT_EQ(pool.noOfHeapAllocations(), 6lu) << "updates not allocated from the pool in steady state";
+}
+
+TEST(UpdatePoolTest, inPlaceData_OverrideMovesData) {
+    epicsTime ts = epicsTime::getCurrent();
+    TestUpdate u0(ts, ProcessReason::incomingData, std::string("old"), 0);
+    TestUpdate u1(ts, ProcessReason::incomingData, std::string("new"), 1);
+    u0.override(u1);
+    EXPECT_EQ(u0.getData(), "new") << "data not moved by override";
+    EXPECT_EQ(bool(u1), false) << "overriding update still has data";
+
+    TestUpdate u2(ts, ProcessReason::connectionLoss);
+    u0.override(u2);
+    EXPECT_EQ(bool(u0), false) << "override with event keeps old data";
+}
+
+} // namespace
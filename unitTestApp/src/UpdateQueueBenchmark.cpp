@@ -0,0 +1,102 @@
+/*************************************************************************\
+* Copyright (c) 2020 ITER Organization.
+* This module is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/*
+ *  Author: Ralph Lange <ralph.lange@gmx.de>
+ */
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <gtest/gtest.h>
+
+#include <epicsTime.h>
+
+#include "UpdateQueue.h"
+#include "RingUpdateQueue.h"
+#include "Update.h"
+
+// Throughput benchmark for the incoming update queues of the data elements.
+// Compares the mutex protected UpdateQueue against the RingUpdateQueue,
+// with one producer (client library) and one consumer (record processing) thread.
+// Not run as part of the regular test suite - results are printed on stdout.
+
+namespace {
+
+using namespace DevOpcua;
+
+typedef Update<int, unsigned short> TestUpdate;
+
+const unsigned int updatesPerRun = 1000000;
+const size_t queueSizes[] = { 2, 10, 100, 1000 };
+
+// Producer pushes updatesPerRun updates (prepared in advance), consumer pops until done.
+// Returns the throughput [updates/s]; number of popped updates in received
+template<typename Q>
+double
+runQueue(Q &queue, unsigned long &received)
+{
+    epicsTime ts;
+    std::vector<std::shared_ptr<TestUpdate>> updates;
+    updates.reserve(updatesPerRun);
+    for (unsigned int i = 0; i < updatesPerRun; i++)
+        updates.emplace_back(std::make_shared<TestUpdate>(ts, ProcessReason::incomingData, static_cast<int>(i), 0));
+
+    std::atomic<bool> go(false);
+    std::atomic<bool> done(false);
+    received = 0;
+
+    std::thread consumer([&]() {
+        while (!go) std::this_thread::yield();
+        for (;;) {
+            if (queue.empty()) {
+                if (done && queue.empty()) break;
+                continue;
+            }
+            queue.popUpdate();
+            received++;
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto &u : updates)
+        queue.pushUpdate(u);
+    done = true;
+    consumer.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return updatesPerRun / elapsed.count();
+}
+
+TEST(UpdateQueueBenchmark, pushPop_LockedVsRing) {
+    std::cout << std::setw(10) << "capacity"
+              << std::setw(18) << "locked [upd/s]"
+              << std::setw(14) << "(popped)"
+              << std::setw(18) << "ring [upd/s]"
+              << std::setw(14) << "(popped)"
+              << std::setw(8) << "gain" << std::endl;
+    for (auto size : queueSizes) {
+        UpdateQueue<TestUpdate> lq(size);
+        RingUpdateQueue<TestUpdate> rq(size);
+        unsigned long lpopped, rpopped;
+        double locked = runQueue(lq, lpopped);
+        double ring = runQueue(rq, rpopped);
+        EXPECT_TRUE(rq.empty()) << "Ring queue not empty after run";
+        std::cout << std::setw(10) << size
+                  << std::setw(18) << std::fixed << std::setprecision(0) << locked
+                  << std::setw(14) << lpopped
+                  << std::setw(18) << ring
+                  << std::setw(14) << rpopped
+                  << std::setw(8) << std::setprecision(2) << ring / locked << std::endl;
+    }
+}
+
+} // namespace
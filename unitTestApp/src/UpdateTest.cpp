@@ -42,6 +42,17 @@ TEST(UpdateTest, UpdateConstructor_WithDataRef_DataCorrectAndManaged) {
     EXPECT_EQ(*pi, 1) << "Data released from new Update (" << *pi << ") differs from the provided data (1)";
 }
 
+TEST(UpdateTest, UpdateConstructor_WithConvertibleData_DataBuiltInPlace) {
+    epicsTime ts;
+    ts.getCurrent();
+    const short s = 7;
+
+    TestUpdate u0(ts, ProcessReason::incomingData, s, 101);
+    EXPECT_EQ(bool(u0), true) << "New Update (created from convertible data) does not have data (operator bool returns false)";
+    EXPECT_EQ(u0.getData(), 7) << "Data from new Update (" << u0.getData() << ") differs from the provided data (7)";
+    EXPECT_EQ(u0.getStatus(), 101u) << "New Update status differs from the provided status";
+}
+
 TEST(UpdateTest, UpdateConstructor_WithUniquePtr_DataCorrectAndManaged) {
     epicsTime ts;
     ts.getCurrent();